@@ -1,7 +1,7 @@
 #!/bin/bash
 
 SHADER_DIR="shaders"
-UXN_SHADERS="uxn_emu blit"
+UXN_SHADERS="uxn_emu blit raster present"
 GRAPHICS_SHADERS="shader.vert shader.frag"
 
 #cd ..
@@ -19,6 +19,10 @@ for shader in $UXN_SHADERS; do
   #spirv-dis "${shader}".spv -o "${shader}".spv.txt
 done
 
+# blit variant that records per-region worker statistics (-s)
+echo "Compiling blit with PARALLEL_STATS"
+glslangValidator -V --target-env vulkan1.2 -DPARALLEL_STATS blit.comp -o blit_stats.spv
+
 for shader in $GRAPHICS_SHADERS; do
   echo "Compiling $shader.glsl"
   # Compiling
@@ -31,5 +35,8 @@ xxd -i shaders/shader.vert.spv > src/shaders/vert.h
 xxd -i shaders/shader.frag.spv > src/shaders/frag.h
 xxd -i shaders/uxn_emu.spv > src/shaders/uxn_emu.h
 xxd -i shaders/blit.spv > src/shaders/blit.h
+xxd -i shaders/blit_stats.spv > src/shaders/blit_stats.h
+xxd -i shaders/raster.spv > src/shaders/raster.h
+xxd -i shaders/present.spv > src/shaders/present.h
 
 echo "Shaders compiled successfully!"
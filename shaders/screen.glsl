@@ -0,0 +1,125 @@
+#ifndef SCREEN_GLSL
+#define SCREEN_GLSL
+//
+// Screen drawing shared by blit.comp and raster.comp
+//
+
+/* Deferred draw command, issued by a worker inside a Parallel region or by a Screen DEO in deferred mode
+ * pos    - x | y << 16 of the pixel, sprite or fill corner
+ * op     - pixel/sprite byte | kind << 8
+ * key    - worker << 16 | draw index of that worker, unused on the Screen draw list
+ * extent - x | y << 16 of the opposite fill corner
+ * tile   - decoded sprite at the time of the draw, see decode_tile()
+ */
+struct DrawCmd {
+    uint pos;
+    uint op;
+    uint key;
+    uint extent;
+    uvec4 tile;
+};
+
+#define DRAW_CMD_PIXEL  1u
+#define DRAW_CMD_FILL   2u
+#define DRAW_CMD_SPRITE 3u
+
+// Must match SCREEN_LIST_SIZE in DeviceController.cpp
+#define SCREEN_LIST_SIZE 65536u
+
+// returned instead of a palette index for sprite pixels that are left untouched
+#define PIXEL_CLEAR 4u
+
+// Blending Chart
+const uint blending[4][16] = uint[4][16](
+    uint[16](0, 0, 0, 0, 1, 0, 1, 1, 2, 2, 0, 2, 3, 3, 3, 0),
+    uint[16](0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3),
+    uint[16](1, 2, 3, 1, 1, 2, 3, 1, 1, 2, 3, 1, 1, 2, 3, 1),
+    uint[16](2, 3, 1, 2, 2, 3, 1, 2, 2, 3, 1, 2, 2, 3, 1, 2)
+);
+
+// Palette index (or PIXEL_CLEAR) of each 2-bit pixel value for a sprite mode, 4 bits per value
+uint sprite_blend_lut(uint sprite_low) {
+    bool opaque = sprite_low % 5 != 0; // for 0, 5, a, f, off bits are left as is
+    uint lut = 0;
+    for (uint v = 0; v < 4; v++) {
+        uint index = (opaque || v != 0) ? blending[v][sprite_low] : PIXEL_CLEAR;
+        lut |= index << (v * 4u);
+    }
+    return lut;
+}
+
+// Spreads the 8 bits of a byte over the even bits of a short
+uint spread_bits(uint b) {
+    b = (b | (b << 4)) & 0x0f0fu;
+    b = (b | (b << 2)) & 0x3333u;
+    return (b | (b << 1)) & 0x5555u;
+}
+
+// The 2-bit values of the 8 pixels of a sprite row, leftmost pixel in the top bits. high is 0 for 1bpp
+uint decode_sprite(uint low, uint high) {
+    return spread_bits(low) | (spread_bits(high) << 1);
+}
+
+uint sprite_pixel(uint lut, uint row, uint x) {
+    return (lut >> (((row >> ((7u - x) * 2u)) & 3u) * 4u)) & 0xfu;
+}
+
+uint tile_row(uvec4 tile, uint y) {
+    return (tile[y >> 1] >> ((y & 1u) * 16u)) & 0xffffu;
+}
+
+uint pack_coords(ivec2 coords) {
+    return uint(coords.x & 0xffff) | (uint(coords.y & 0xffff) << 16);
+}
+
+// Pixels and fills use the unsigned Screen coordinates, sprites may start left of or above the screen
+ivec2 unpack_coords(uint packed) {
+    return ivec2(packed & 0xffff, packed >> 16);
+}
+
+ivec2 unpack_sprite_coords(uint packed) {
+    return ivec2(int(packed << 16) >> 16, int(packed) >> 16);
+}
+
+// Whether the command touches the pixels in [lo, hi)
+bool draw_cmd_overlaps(DrawCmd c, ivec2 lo, ivec2 hi) {
+    uint kind = c.op >> 8;
+    ivec2 a, e;
+    if (kind == DRAW_CMD_SPRITE) {
+        a = unpack_sprite_coords(c.pos);
+        e = a + 8;
+    } else if (kind == DRAW_CMD_FILL) {
+        a = unpack_coords(c.pos);
+        e = unpack_coords(c.extent);
+    } else {
+        a = unpack_coords(c.pos);
+        e = a + 1;
+    }
+    return all(lessThan(max(a, lo), min(e, hi)));
+}
+
+/* Applies a command to the layer indices of pixel p. lut is sprite_blend_lut() of the
+ * sprite byte, passed in so it is worked out once per command rather than per pixel. */
+void draw_cmd_apply(DrawCmd c, uint lut, ivec2 p, inout uint bg, inout uint fg) {
+    uint kind = c.op >> 8;
+    uint b = c.op & 0xffu;
+
+    if (kind == DRAW_CMD_SPRITE) {
+        ivec2 o = p - unpack_sprite_coords(c.pos);
+        if (any(lessThan(o, ivec2(0))) || any(greaterThan(o, ivec2(7)))) return;
+        if ((b & 0x10u) != 0) o.x = 7 - o.x;
+        if ((b & 0x20u) != 0) o.y = 7 - o.y;
+        uint v = sprite_pixel(lut, tile_row(c.tile, uint(o.y)), uint(o.x));
+        if (v == PIXEL_CLEAR) return;
+        if ((b & 0x40u) != 0) fg = v; else bg = v;
+    } else if (kind == DRAW_CMD_PIXEL) {
+        if (p != unpack_coords(c.pos)) return;
+        if (b / 0x10u == 0x0u) bg = b & 0x03u;
+        if (b / 0x10u == 0x4u) fg = b & 0x03u;
+    } else if (kind == DRAW_CMD_FILL) {
+        if (any(lessThan(p, unpack_coords(c.pos))) || any(greaterThanEqual(p, unpack_coords(c.extent)))) return;
+        if ((b & 0x40u) != 0) fg = b & 0x03u; else bg = b & 0x03u;
+    }
+}
+
+#endif // SCREEN_GLSL
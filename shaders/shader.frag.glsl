@@ -2,14 +2,18 @@
 layout(location = 0) in vec2 fragUV;
 layout(location = 0) out vec4 outColor;
 
-layout(set = 0, binding = 4) uniform sampler2D background;
-layout(set = 0, binding = 5) uniform sampler2D foreground;
+// layers hold 2-bit palette indices, foreground index 0 is transparent
+layout(set = 0, binding = 4) uniform usampler2D background;
+layout(set = 0, binding = 5) uniform usampler2D foreground;
+
+layout(set = 0, binding = 8) uniform Palette {
+    vec4 colours[4];
+    uvec2 size; // visible part of the layers, which can be allocated larger
+} palette;
 
 void main() {
-    vec4 foregroundColor = texture(foreground, fragUV);
-    if (foregroundColor.a != 0.0) {
-        outColor = foregroundColor;
-    } else {
-        outColor = texture(background, fragUV);
-    }
+    vec2 uv = fragUV * vec2(palette.size) / vec2(textureSize(foreground, 0));
+    uint fg = texture(foreground, uv).r;
+    uint bg = texture(background, uv).r;
+    outColor = palette.colours[fg != 0u ? fg : bg];
 }
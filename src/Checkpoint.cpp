@@ -0,0 +1,102 @@
+#include "Checkpoint.hpp"
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+static size_t vectorsOffset() {
+    return sizeof(CheckpointHeader) + sizeof(UxnMemory::shared) + sizeof(UxnMemory::_private);
+}
+
+void writeCheckpoint(const std::string &path, uint64_t romHash, const CheckpointState &state) {
+    CheckpointHeader header{};
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.flags = state.layers.empty() ? 0 : CHECKPOINT_LAYERS;
+    header.romHash = romHash;
+    header.sharedSize = sizeof(UxnMemory::shared);
+    header.privateSize = sizeof(UxnMemory::_private);
+    header.vectorCount = state.vectors.size();
+    header.width = state.width;
+    header.height = state.height;
+
+    std::vector<CheckpointVector> vectors;
+    for (const auto &[device, address] : state.vectors) {
+        vectors.push_back({static_cast<uint8_t>(device), 0, address});
+    }
+
+    std::filesystem::path temporary = path;
+    temporary += "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open checkpoint " + temporary.string() + "!");
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(&state.shared), sizeof(state.shared));
+        file.write(reinterpret_cast<const char*>(&state._private), sizeof(state._private));
+        file.write(reinterpret_cast<const char*>(vectors.data()), static_cast<long>(vectors.size() * sizeof(CheckpointVector)));
+        file.write(reinterpret_cast<const char*>(state.layers.data()), static_cast<long>(state.layers.size()));
+        if (!file) {
+            file.close();
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+            throw std::runtime_error("failed to write checkpoint " + temporary.string() + "!");
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::error_code ignored;
+        std::filesystem::remove(temporary, ignored);
+        throw std::runtime_error("failed to replace checkpoint " + path + ": " + error.message() + "!");
+    }
+}
+
+CheckpointFile::CheckpointFile(const std::string &path, uint64_t romHash) : file(path) {
+    data = file.data();
+    auto reject = [&path](const char* reason) {
+        throw std::runtime_error("checkpoint " + path + " " + reason + "!");
+    };
+    if (file.size() < vectorsOffset()) reject("is truncated");
+    const CheckpointHeader &h = header();
+    if (memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) != 0) reject("is not a checkpoint");
+    if (h.version != CHECKPOINT_VERSION) reject("has an unsupported version");
+    if (h.sharedSize != sizeof(UxnMemory::shared) || h.privateSize != sizeof(UxnMemory::_private)) {
+        reject("was written by an incompatible build");
+    }
+    if (h.romHash != romHash) reject("was written for a different ROM");
+    size_t expected = vectorsOffset() + h.vectorCount * sizeof(CheckpointVector);
+    if (h.flags & CHECKPOINT_LAYERS) expected += 2ull * h.width * h.height;
+    if (file.size() < expected) reject("is truncated");
+}
+
+const CheckpointHeader &CheckpointFile::header() const {
+    return *reinterpret_cast<const CheckpointHeader*>(data);
+}
+
+const decltype(UxnMemory::shared) &CheckpointFile::shared() const {
+    return *reinterpret_cast<const decltype(UxnMemory::shared)*>(data + sizeof(CheckpointHeader));
+}
+
+const void* CheckpointFile::privateMemory() const {
+    return data + sizeof(CheckpointHeader) + sizeof(UxnMemory::shared);
+}
+
+std::unordered_map<uxn_device, uint16_t> CheckpointFile::vectors() const {
+    std::unordered_map<uxn_device, uint16_t> result;
+    for (uint32_t i = 0; i < header().vectorCount; i++) {
+        CheckpointVector entry{}; // the private memory has an odd size, so the entries may be unaligned
+        memcpy(&entry, data + vectorsOffset() + i * sizeof(CheckpointVector), sizeof(entry));
+        result[static_cast<uxn_device>(entry.device)] = entry.address;
+    }
+    return result;
+}
+
+const uint8_t* CheckpointFile::layer(uint32_t index) const {
+    const CheckpointHeader &h = header();
+    if (!(h.flags & CHECKPOINT_LAYERS)) return nullptr;
+    return data + vectorsOffset() + h.vectorCount * sizeof(CheckpointVector)
+         + static_cast<size_t>(index) * h.width * h.height;
+}
@@ -0,0 +1,73 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "Uxn.hpp"
+
+#define CHECKPOINT_MAGIC   "UXNCKPT"
+#define CHECKPOINT_VERSION 1
+// header flags
+#define CHECKPOINT_LAYERS  0x1 // background and foreground follow the vectors
+
+/// Start of a checkpoint file. It is followed by the shared state, the private memory (RAM and stacks),
+/// vectorCount CheckpointVectors and, with CHECKPOINT_LAYERS, the background and foreground layers of
+/// width * height palette indices each. All of it is stored as it is in memory, so it can be uploaded from
+/// the mapped file as is.
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t romHash;     // hashBytes() of the ROM, a checkpoint only resumes the ROM it was written by
+    uint32_t sharedSize;  // sizeof the state structs of the build that wrote it
+    uint32_t privateSize;
+    uint32_t vectorCount;
+    uint32_t width;       // Screen size
+    uint32_t height;
+    uint32_t reserved;
+};
+
+struct CheckpointVector {
+    uint8_t device;
+    uint8_t reserved;
+    uint16_t address;
+};
+
+/// VM state handed to writeCheckpoint(), copied out of the live state so it can be written on another thread
+struct CheckpointState {
+    decltype(UxnMemory::shared) shared;
+    decltype(UxnMemory::_private) _private;
+    std::unordered_map<uxn_device, uint16_t> vectors;
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> layers; // background then foreground, empty to leave them out
+};
+
+/// Writes a temporary file next to path and renames it over path, so a crash never leaves half a checkpoint
+void writeCheckpoint(const std::string &path, uint64_t romHash, const CheckpointState &state);
+
+/// A checkpoint file mapped read only, the state it holds is read straight from the mapping
+class CheckpointFile {
+public:
+    /// Throws when the file is missing, truncated, of another version or build, or written for another ROM
+    CheckpointFile(const std::string &path, uint64_t romHash);
+
+    [[nodiscard]] const CheckpointHeader &header() const;
+
+    [[nodiscard]] const decltype(UxnMemory::shared) &shared() const;
+
+    [[nodiscard]] const void* privateMemory() const;
+
+    [[nodiscard]] std::unordered_map<uxn_device, uint16_t> vectors() const;
+
+    /// Layer 0 is the background and 1 the foreground, nullptr when the file has no layers
+    [[nodiscard]] const uint8_t* layer(uint32_t index) const;
+private:
+    MappedFile file;
+    const uint8_t* data;
+};
+
+#endif //CHECKPOINT_HPP
@@ -1,23 +1,36 @@
 #define GLFW_INCLUDE_VULKAN
 #include "DeviceController.hpp"
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <set>
 #include <string>
 #include <thread>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
+#include "Checkpoint.hpp"
 #include "Console.hpp"
 #include "EventQueue.hpp"
 #include "FPSLogger.hpp"
+#include "ParallelStats.hpp"
 #include "Io.hpp"
+#include "MemoryArena.hpp"
+#include "PipelineCache.hpp"
 #include "Resource.hpp"
+#include "RomAnalysis.hpp"
+#include "UploadRing.hpp"
 #include "Uxn.hpp"
 #include "shaders/vert.h"
 #include "shaders/frag.h"
 #include "shaders/uxn_emu.h"
 #include "shaders/blit.h"
+#include "shaders/blit_stats.h"
+#include "shaders/raster.h"
+#include "shaders/present.h"
 #include <csignal>
+#include <future>
+#include <memory>
 
 // Window Dimensions that matches uxn default
 int WIDTH = 512;
@@ -30,6 +43,88 @@ int HEIGHT = 320;
 #define BACKGROUND_SAMPLER_BINDING  4
 #define FOREGROUND_IMAGE_BINDING    3
 #define FOREGROUND_SAMPLER_BINDING  5
+#define DRAW_LIST_BINDING           6
+#define PARALLEL_STATS_BINDING      7
+#define PALETTE_BINDING             8
+#define TILE_CACHE_BINDING          9
+#define SCREEN_LIST_BINDING         10
+#define PRESENT_IMAGE_BINDING       11
+
+// Must match DRAW_LIST_SIZE and the DrawCmd struct in blit.comp
+#define DRAW_LIST_SIZE      8192
+#define DRAW_CMD_SIZE       32
+
+// Must match the Tile_Cache buffer in blit.comp
+#define TILE_CACHE_SIZE     1024
+#define TILE_CACHE_PAGES    256
+#define TILE_CACHE_BYTES    (16 + 4 * TILE_CACHE_PAGES + 32 * TILE_CACHE_SIZE)
+#define TILE_CACHE_ENTRIES_OFFSET (16 + 4 * TILE_CACHE_PAGES) // after the counters and page generations
+
+// Must match SCREEN_LIST_SIZE in screen.glsl
+#define SCREEN_LIST_SIZE    65536
+#define SCREEN_LIST_HEADER  16 // count, padded to the alignment of the commands
+#define SCREEN_LIST_BYTES   (SCREEN_LIST_HEADER + DRAW_CMD_SIZE * SCREEN_LIST_SIZE)
+#define RASTER_GROUP_SIZE   16
+#define PRESENT_GROUP_SIZE  16
+
+// Memory the host can map without going through a staging copy
+#define MAPPED_DEVICE_MEMORY (VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT \
+                              | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+// Largest BAR window of a discrete GPU without resizable BAR, heaps above it are ReBAR or unified memory
+#define SMALL_BAR_SIZE (256ull * 1024 * 1024)
+
+/// Where the VM state buffers live, chosen from the memory types of the device
+enum class StatePlacement {
+    Staged,       // device local only, copied through hostSrcBuffer/hostDestBuffer
+    MappedShared, // the shared state is mapped, private RAM stays out of the small BAR window
+    MappedAll,    // ReBAR or unified memory, private RAM is mapped too
+};
+
+/// Pixels [x0, x1) x [y0, y1) of the Uxn screen that changed, empty when x0 >= x1 or y0 >= y1
+struct DamageRect {
+    uint32_t x0 = UINT32_MAX, y0 = UINT32_MAX, x1 = 0, y1 = 0;
+
+    [[nodiscard]] bool empty() const { return x0 >= x1 || y0 >= y1; }
+
+    void merge(const DamageRect &other) {
+        if (other.empty()) return;
+        x0 = std::min(x0, other.x0);
+        y0 = std::min(y0, other.y0);
+        x1 = std::max(x1, other.x1);
+        y1 = std::max(y1, other.y1);
+    }
+
+    [[nodiscard]] DamageRect clamped(uint32_t width, uint32_t height) const {
+        return {x0, y0, std::min(x1, width), std::min(y1, height)};
+    }
+};
+
+// Slots of DeviceController::snapshot(), F5 and F9 use slot 0
+#define SNAPSHOT_SLOTS 4
+// How often --watch looks at the ROM's modification time
+#define ROM_POLL_INTERVAL std::chrono::milliseconds(100)
+
+/// VM state and layers saved by DeviceController::snapshot(). The copies stay device local, so saving and
+/// restoring are a few GPU copies rather than a round trip through the host.
+struct VmSnapshot {
+    VkBuffer sharedBuffer = VK_NULL_HANDLE;
+    VkBuffer privateBuffer = VK_NULL_HANDLE;
+    MemoryAllocation sharedMemory{};
+    MemoryAllocation privateMemory{};
+    std::array<VkImage, 2> layers{}; // background, foreground
+    std::array<MemoryAllocation, 2> layerMemory{};
+    VkExtent2D layerExtent{};        // allocated size of the layer copies
+    VkExtent2D screen{};             // Screen size when the snapshot was taken
+    decltype(UxnMemory::shared) hostShared; // the host copy, uploaded with every vector
+    std::unordered_map<uxn_device, uint16_t> vectors;
+    bool taken = false;
+};
+
+// Must match the Palette uniform in shader.frag.glsl and present.comp
+struct PaletteUniform {
+    std::array<glm::vec4, 4> colours;
+    glm::uvec2 size; // visible part of the layers, which can be allocated larger
+};
 
 #define VERTEX_BINDING 0
 #define VERTEX_LOCATION 6
@@ -70,6 +165,7 @@ typedef struct vertex {
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsAndComputeFamily;
     std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> transferFamily; // transfer only, unset when the device has none
 
     bool isComplete() {
         return graphicsAndComputeFamily.has_value() && presentFamily.has_value();
@@ -102,6 +198,17 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surfa
         if (indices.isComplete()) break;
     }
 
+    // a transfer only family can run uploads next to the VM, as long as it copies single texels
+    for (uint32_t i = 0; i < queueFamilyCount; ++i) {
+        VkQueueFlags flags = queueFamilies[i].queueFlags;
+        VkExtent3D granularity = queueFamilies[i].minImageTransferGranularity;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+            && granularity.width == 1 && granularity.height == 1 && granularity.depth == 1) {
+            indices.transferFamily = i;
+            break;
+        }
+    }
+
     return indices;
 }
 
@@ -147,7 +254,13 @@ VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>
     return availableFormats[0];
 }
 
-VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
+VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes,
+                                       std::optional<VkPresentModeKHR> requested = std::nullopt) {
+    if (requested) {
+        if (std::ranges::find(availablePresentModes, *requested) != availablePresentModes.end()) return *requested;
+        std::cerr << "Requested present mode is not supported by the surface, using FIFO\n";
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
     for (const auto& availablePresentMode : availablePresentModes) {
         if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
             return availablePresentMode;
@@ -224,6 +337,45 @@ bool checkDeviceExtensionSupport(VkPhysicalDevice device, std::vector<const char
     return requiredExtensions.empty();
 }
 
+/// Whether blit_stats.spv (-s) can run, it votes and ballots across the subgroup in a compute shader
+bool parallelStatsSupported(VkPhysicalDevice device) {
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+    if (deviceProperties.apiVersion < VK_API_VERSION_1_1) return false;
+
+    VkPhysicalDeviceSubgroupProperties subgroup{};
+    subgroup.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &subgroup;
+    vkGetPhysicalDeviceProperties2(device, &properties);
+    constexpr VkSubgroupFeatureFlags needed = VK_SUBGROUP_FEATURE_VOTE_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+    return (subgroup.supportedOperations & needed) == needed
+        && (subgroup.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT);
+}
+
+/// The layers are stored as palette indices, written by blit.comp and sampled by shader.frag.glsl
+bool layerFormatSupported(VkPhysicalDevice device) {
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(device, LAYER_FORMAT, &props);
+    constexpr VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+                                          | VK_FORMAT_FEATURE_TRANSFER_DST_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+    return (props.optimalTilingFeatures & needed) == needed;
+}
+
+/// Whether present.comp can write the swapchain images directly instead of going through the render pass
+bool computePresentSupported(VkPhysicalDevice device, VkSurfaceKHR surface, VkFormat format) {
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(device, &features);
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &capabilities);
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(device, format, &props);
+    return features.shaderStorageImageWriteWithoutFormat
+        && (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT)
+        && (props.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT);
+}
+
 bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface, std::vector<const char*> deviceExtensions) {
     VkPhysicalDeviceProperties deviceProperties;
     vkGetPhysicalDeviceProperties(device, &deviceProperties);
@@ -258,7 +410,9 @@ bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface, std::vector
         && vk12Features.uniformAndStorageBuffer8BitAccess
         && vk12Features.shaderInt8
         && vk11Features.storageBuffer16BitAccess
-        && features2.features.shaderInt16;
+        && features2.features.shaderInt16
+        && features2.features.shaderStorageImageExtendedFormats
+        && layerFormatSupported(device);
 }
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
@@ -317,12 +471,19 @@ void endSingleTimeCommands(const Context &ctx, VkCommandBuffer commandBuffer) {
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    vkQueueSubmit(ctx.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(ctx.graphicsQueue);
+    vkQueueSubmit(ctx.graphicsQueue, 1, &submitInfo, ctx.singleTimeFence);
+    vkWaitForFences(ctx.device, 1, &ctx.singleTimeFence, VK_TRUE, UINT64_MAX);
+    vkResetFences(ctx.device, 1, &ctx.singleTimeFence);
 
     vkFreeCommandBuffers(ctx.device, ctx.commandPool, 1, &commandBuffer);
 }
 
+/// How frames reach the screen, chosen on the command line
+struct PresentConfig {
+    std::optional<VkPresentModeKHR> presentMode; // unset picks MAILBOX when available, FIFO otherwise
+    uint32_t framesInFlight = 1;                 // frames the CPU may record before waiting for the GPU
+};
+
 static GLFWwindow* g_window = nullptr;
 
 void benchmark_signal_handler(int) {
@@ -333,6 +494,11 @@ class DeviceController {
 public:
     bool debug;
     bool logMetrics;
+    bool logParallelStats;
+    bool deferredScreen;
+    bool computePresent = false;
+    StatePlacement statePlacement = StatePlacement::Staged;
+    PresentConfig presentConfig;
 #define H 1.0
 #define T 1.0
 #define L (-H)
@@ -354,64 +520,315 @@ public:
         std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
     #endif
 
-    DeviceController(bool enableValidationLayers, Uxn* uxn, Console* console, EventQueue* gpuEventQueue){
+    DeviceController(bool enableValidationLayers, bool parallelStats, bool deferredScreen, PresentConfig presentConfig,
+                     const char* romPath, std::string checkpointPath, bool resume, bool watchRom,
+                     Console* console, EventQueue* gpuEventQueue){
         this->debug = enableValidationLayers;
-        this->uxn = uxn;
-        uxn->debug = enableValidationLayers;
+        this->logParallelStats = parallelStats;
+        this->deferredScreen = deferredScreen;
+        this->presentConfig = presentConfig;
+        this->romPath = romPath;
+        this->checkpointPath = std::move(checkpointPath);
+        this->resume = resume;
+        this->watchRom = watchRom;
         this->console = console;
         this->gpuEventQueue = gpuEventQueue;
         init();
     }
 
     void run() {
+        if (logMetrics) printStatePlacement();
         if (logMetrics) logger.logStart();
         LOG("Starting VM execution:");
         mainLoop();
         if (logMetrics) logger.logEnd();
         if (logMetrics) logger.printMetrics();
+        if (logMetrics) printTileCacheMetrics();
+        if (logMetrics) memoryArena.printMetrics();
+        if (logParallelStats) parallelStats.printMetrics();
         cleanup();
     }
+
+    /// Copies the VM state and both layers into a snapshot slot, only between vectors
+    void snapshot(uint32_t slot) {
+        auto start = std::chrono::steady_clock::now();
+        VmSnapshot &snap = snapshots.at(slot);
+        if (snap.sharedBuffer == VK_NULL_HANDLE) {
+            createBuffer(ctx, sizeof(UxnMemory::shared),
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, snap.sharedBuffer, snap.sharedMemory);
+            createBuffer(ctx, sizeof(UxnMemory::_private),
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, snap.privateBuffer, snap.privateMemory);
+        }
+        bool newLayers = snap.layerExtent.width < uxn_width || snap.layerExtent.height < uxn_height;
+        if (newLayers) {
+            for (uint32_t i = 0; i < 2; i++) {
+                if (snap.layers[i] != VK_NULL_HANDLE) destroyImage(ctx, snap.layers[i], snap.layerMemory[i]);
+                createImage(ctx, uxn_width, uxn_height, snap.layers[i], snap.layerMemory[i]);
+            }
+            snap.layerExtent = {uxn_width, uxn_height};
+        }
+
+        VkCommandBuffer cmdBuffer = beginSingleTimeCommands(ctx);
+        // the copies stay in GENERAL like the layers, so either can be the source
+        std::vector<VkImageMemoryBarrier> layouts;
+        for (VkImage image : snap.layers) {
+            if (!newLayers) break;
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image;
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            layouts.push_back(barrier);
+        }
+        // the last dispatch wrote the state and the layers, a restore may have read the slot
+        VkMemoryBarrier written{};
+        written.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        written.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        written.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &written, 0, nullptr,
+                             layouts.size(), layouts.data());
+        copyState(cmdBuffer, sharedUxnResource.data.buffer._, privateUxnResource.data.buffer._,
+                  snap.sharedBuffer, snap.privateBuffer);
+        std::array<VkImage, 2> layers = {backgroundImageResource.data.image._, foregroundImageResource.data.image._};
+        VkImageCopy region{};
+        region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.extent = {uxn_width, uxn_height, 1};
+        for (uint32_t i = 0; i < 2; i++) {
+            vkCmdCopyImage(cmdBuffer, layers[i], VK_IMAGE_LAYOUT_GENERAL,
+                           snap.layers[i], VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+        }
+        endSingleTimeCommands(ctx, cmdBuffer);
+
+        snap.screen = {uxn_width, uxn_height};
+        snap.hostShared = uxn->memory->shared;
+        snap.vectors = uxn->deviceCallbackVectors;
+        snap.taken = true;
+        LOG("Snapshot " << slot << " saved in " << std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count() << " us");
+    }
+
+    /// Puts the VM state and layers of a snapshot slot back, only between vectors. Returns false for an empty slot.
+    bool restore(uint32_t slot) {
+        auto start = std::chrono::steady_clock::now();
+        VmSnapshot &snap = snapshots.at(slot);
+        if (!snap.taken) return false;
+        resizeScreen(snap.screen.width, snap.screen.height);
+        // frames in flight may still sample the layers
+        vkWaitForFences(ctx.device, graphicsFences.size(), graphicsFences.data(), VK_TRUE, UINT64_MAX);
+
+        VkCommandBuffer cmdBuffer = beginSingleTimeCommands(ctx);
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+                             | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+        copyState(cmdBuffer, snap.sharedBuffer, snap.privateBuffer,
+                  sharedUxnResource.data.buffer._, privateUxnResource.data.buffer._);
+        std::array<VkImage, 2> layers = {backgroundImageResource.data.image._, foregroundImageResource.data.image._};
+        VkImageCopy region{};
+        region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.extent = {snap.screen.width, snap.screen.height, 1};
+        for (uint32_t i = 0; i < 2; i++) {
+            vkCmdCopyImage(cmdBuffer, snap.layers[i], VK_IMAGE_LAYOUT_GENERAL,
+                           layers[i], VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+        }
+        // RAM changed under the decoded sprites, their generations no longer say so
+        vkCmdFillBuffer(cmdBuffer, tileCacheResource.data.buffer._, TILE_CACHE_ENTRIES_OFFSET,
+                        TILE_CACHE_BYTES - TILE_CACHE_ENTRIES_OFFSET, 0);
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                             | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+        endSingleTimeCommands(ctx, cmdBuffer);
+
+        uxn->memory->shared = snap.hostShared;
+        uxn->restoreCallbackVectors(snap.vectors);
+        dirtyPages.fill(UINT32_MAX); // the host copy of private memory is behind all of it now
+        refreshPalette();
+        paletteDirty = true;
+        markFullDamage();
+        LOG("Snapshot " << slot << " restored in " << std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count() << " us");
+        return true;
+    }
+
+    /// Loads the ROM file again and boots it from the reset vector on the existing device, swapchain and
+    /// pipelines: RAM and stacks are uploaded, the device page and vectors reset and both layers cleared.
+    /// Returns false and keeps running the old ROM when the file cannot be loaded.
+    bool reloadRom() {
+        auto start = std::chrono::steady_clock::now();
+        try {
+            uxn->reload();
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return false;
+        }
+        romHash = hashBytes(reinterpret_cast<const unsigned char*>(uxn->rom().data()), uxn->rom().size());
+        romAnalysis = std::make_unique<RomAnalysis>(uxn->rom(), romHash);
+        reportRomAnalysis();
+        resizeScreen(static_cast<uint32_t>(WIDTH * H), static_cast<uint32_t>(HEIGHT * H));
+        updateUxnConstants();
+        // frames in flight may still sample the layers
+        vkWaitForFences(ctx.device, graphicsFences.size(), graphicsFences.data(), VK_TRUE, UINT64_MAX);
+
+        if (statePlacement == StatePlacement::MappedAll) {
+            memcpy(privateUxnResource.data.buffer.memory.mapped, &uxn->memory->_private, sizeof(UxnMemory::_private));
+        } else {
+            uploadRing.uploadBuffer(privateUxnResource.data.buffer._, &uxn->memory->_private, sizeof(UxnMemory::_private));
+            uploadRing.wait(uploadRing.flush());
+        }
+        copyHostMemToDevice(uxn->memory);
+
+        VkCommandBuffer cmdBuffer = beginSingleTimeCommands(ctx);
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        // background colour 0, foreground transparent
+        VkClearColorValue clearIndex = {};
+        VkImageSubresourceRange subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkCmdClearColorImage(cmdBuffer, backgroundImageResource.data.image._, VK_IMAGE_LAYOUT_GENERAL,
+                             &clearIndex, 1, &subresourceRange);
+        vkCmdClearColorImage(cmdBuffer, foregroundImageResource.data.image._, VK_IMAGE_LAYOUT_GENERAL,
+                             &clearIndex, 1, &subresourceRange);
+        // the sprites were decoded from the old ROM, and with -r its queued draws must not reach the new layers
+        vkCmdFillBuffer(cmdBuffer, tileCacheResource.data.buffer._, TILE_CACHE_ENTRIES_OFFSET,
+                        TILE_CACHE_BYTES - TILE_CACHE_ENTRIES_OFFSET, 0);
+        vkCmdFillBuffer(cmdBuffer, screenListResource.data.buffer._, 0, sizeof(uint32_t), 0);
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+        endSingleTimeCommands(ctx, cmdBuffer);
+
+        // resizes, clears and inputs of the old ROM
+        while (gpuEventQueue->pop()) {}
+        pendingLayerClears = {};
+        pendingInputs.clear();
+        dirtyPages.fill(0); // the host copy is what was just uploaded
+        refreshPalette();
+        paletteDirty = true;
+        markFullDamage();
+        std::cout << "Reloaded " << romPath << " in " << std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+        return true;
+    }
 private:
     Context ctx;
-    Uxn *uxn;
+    StartupTimer startupTimer;
+    bool firstFramePresented = false;
+    PipelineCache pipelineCache;
+    MemoryArena memoryArena;
+    UploadRing uploadRing;
+    VkQueue transferQueue;
+    uint64_t resourceUploads = 0; // upload ring ticket of the initial buffer and image contents
+    const char* romPath;
+    Uxn *uxn = nullptr;
+    uint64_t romHash = 0;
+    std::unique_ptr<RomAnalysis> romAnalysis;
+    std::string checkpointPath;
+    bool resume = false;                       // start from the checkpoint instead of the reset vector
+    std::unique_ptr<CheckpointFile> checkpoint; // mapped while the resources are created from it
+    std::future<void> checkpointWrite;
+    bool watchRom = false;
+    std::filesystem::file_time_type romWriteTime;     // of the ROM that is running
+    std::filesystem::file_time_type romWriteTimeSeen; // at the last poll
+    std::chrono::steady_clock::time_point nextRomPoll;
+    StartupTimer::Task pipelineCacheSave; // written while the first frames run, joined in cleanup
     Console *console;
     FPSLogger logger;
+    ParallelStats parallelStats;
     uint32_t uxn_width, uxn_height;
+    VkExtent2D layerCapacity;        // allocated size of the layer images, at least the Screen size
+    bool swapChainResizePending = false;
     EventQueue *gpuEventQueue;
 
     VkRenderPass renderPass;
+    VkRenderPass renderPassLoad; // keeps the image contents, for frames that only redraw the damaged area
     VkPipelineLayout graphicsPipelineLayout;
     VkPipeline graphicsPipeline;
-    VkCommandBuffer graphicsCommandBuffer;
+    std::vector<VkCommandBuffer> graphicsCommandBuffers;
 
-    VkPipelineLayout uxnEvaluatePipelineLayout;
-    VkPipeline uxnEvaluatePipeline;
+    // uxn_emu.comp is not dispatched by mainLoop(), so it is only built by the first uxnEvalShader()
+    VkPipelineLayout uxnEvaluatePipelineLayout = VK_NULL_HANDLE;
+    VkPipeline uxnEvaluatePipeline = VK_NULL_HANDLE;
     VkPipelineLayout blitPipelineLayout;
     VkPipeline blitPipeline;
+    VkPipelineLayout rasterPipelineLayout;
+    VkPipeline rasterPipeline;
+    VkPipelineLayout presentPipelineLayout;
+    VkPipeline presentPipeline;
     VkCommandBuffer computeCommandBuffer;
+    VkCommandBuffer rasterCommandBuffer; // not waited for, so it cannot share computeCommandBuffer
 
     DescriptorSetWrapper uxnDescriptorSet;
     DescriptorSetWrapper blitDescriptorSet;
     DescriptorSetWrapper graphicsDescriptorSet;
+    std::vector<DescriptorSetWrapper> presentDescriptorSets; // one per frame in flight
     Resource sharedUxnResource;
     Resource privateUxnResource;
     Resource privateRomResource;
     Resource backgroundImageResource;
     Resource foregroundImageResource;
+    Resource drawListResource;
+    Resource tileCacheResource;
+    Resource screenListResource;
     Resource vertexResource;
 
     VkBuffer hostDestBuffer;
-    VkDeviceMemory hostDestMemory;
+    MemoryAllocation hostDestMemory{};
     VkBuffer hostSrcBuffer;
-    VkDeviceMemory hostSrcMemory;
+    MemoryAllocation hostSrcMemory{};
     void* hostSrcP;
-
-    VkSemaphore imageAvailableSemaphore;
-    VkSemaphore renderFinishedSemaphore;
-    VkFence graphicsFence;
+    VkBuffer privateReadbackBuffer = VK_NULL_HANDLE;
+    MemoryAllocation privateReadbackMemory{};
+    std::array<uint32_t, UXN_DIRTY_WORDS> dirtyPages{}; // written on the GPU since downloadDirtyPages()
+    std::array<VmSnapshot, SNAPSHOT_SLOTS> snapshots;
+
+    VkBuffer statsBuffer;
+    MemoryAllocation statsMemory{};
+    ParallelStatsBuffer* statsP;
+
+    VkBuffer paletteBuffer;
+    MemoryAllocation paletteMemory{};
+    PaletteUniform* paletteP;
+    std::array<glm::vec4, 4> palette{};
+    bool paletteDirty = false;
+    // palette index of a whole-layer fill for each layer (background, foreground), recorded by the next blit
+    std::array<std::optional<uint8_t>, 2> pendingLayerClears;
+
+    // damage since the last present, and per swapchain image since it was last drawn
+    DamageRect frameDamage;
+    // arrival times of the inputs consumed since the last present
+    std::vector<std::chrono::steady_clock::time_point> pendingInputs;
+    std::vector<DamageRect> imageDamage;
+    std::vector<bool> imageHasContent;
+
+    // per frame in flight, currentFrame picks the set the next frame uses
+    std::vector<VkSemaphore> imageAvailableSemaphores;
+    std::vector<VkSemaphore> renderFinishedSemaphores;
+    std::vector<VkFence> graphicsFences;
+    uint32_t currentFrame = 0;
     VkFence computeInFlightFence;
     VkFence uxnEvaluationFence;
     VkFence blitFence;
+    VkFence rasterFence;
 
     bool checkValidationLayerSupport() {
         uint32_t layerCount;
@@ -556,10 +973,20 @@ private:
 
     void initLogicalDevice() {
         LOG("..initLogicalDevice");
-        auto [graphicsAndComputeFamily, presentFamily] = findQueueFamilies(ctx.physicalDevice, ctx.surface);
+        auto [graphicsAndComputeFamily, presentFamily, transferFamily] = findQueueFamilies(ctx.physicalDevice, ctx.surface);
+        if (logParallelStats && !parallelStatsSupported(ctx.physicalDevice)) {
+            throw std::runtime_error("-s needs subgroup vote and ballot operations in compute shaders, "
+                                     "which this GPU does not support");
+        }
+        auto formats = querySwapChainSupport(ctx.physicalDevice, ctx.surface).formats;
+        computePresent = computePresentSupported(ctx.physicalDevice, ctx.surface, chooseSwapSurfaceFormat(formats).format);
+        LOG(" presenting through " << (computePresent ? "present.comp" : "the render pass"));
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set uniqueQueueFamilies = {graphicsAndComputeFamily.value(), presentFamily.value()};
+        ctx.graphicsQueueFamily = graphicsAndComputeFamily.value();
+        ctx.transferQueueFamily = transferFamily.value_or(ctx.graphicsQueueFamily);
+        LOG(" uploading on " << (transferFamily ? "a dedicated transfer queue" : "the graphics queue"));
+        std::set uniqueQueueFamilies = {graphicsAndComputeFamily.value(), presentFamily.value(), ctx.transferQueueFamily};
         float queuePriority = 1.0f;
         for (uint32_t queueFamily: uniqueQueueFamilies) {
             VkDeviceQueueCreateInfo queueCreateInfo{};
@@ -585,6 +1012,8 @@ private:
         VkPhysicalDeviceFeatures2 deviceFeatures2{};
         deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
         deviceFeatures2.features.shaderInt16 = VK_TRUE;
+        deviceFeatures2.features.shaderStorageImageExtendedFormats = VK_TRUE;
+        deviceFeatures2.features.shaderStorageImageWriteWithoutFormat = computePresent;
         deviceFeatures2.pNext = &vk12Features;
 
         VkDeviceCreateInfo createInfo{};
@@ -609,6 +1038,10 @@ private:
         vkGetDeviceQueue(ctx.device, presentFamily.value(), 0, &ctx.presentQueue);
         vkGetDeviceQueue(ctx.device, graphicsAndComputeFamily.value(), 0, &ctx.graphicsQueue);
         vkGetDeviceQueue(ctx.device, graphicsAndComputeFamily.value(), 0, &ctx.computeQueue);
+        vkGetDeviceQueue(ctx.device, ctx.transferQueueFamily, 0, &transferQueue);
+
+        memoryArena.init(ctx.physicalDevice, ctx.device);
+        ctx.memoryArena = &memoryArena;
     }
 
     void initDebug() {
@@ -636,10 +1069,11 @@ private:
         auto [capabilities, formats, presentModes] = querySwapChainSupport(ctx.physicalDevice, ctx.surface);
 
         auto [surfaceFormat, surfaceColorSpace] = chooseSwapSurfaceFormat(formats);
-        VkPresentModeKHR presentMode = chooseSwapPresentMode(presentModes);
+        VkPresentModeKHR presentMode = chooseSwapPresentMode(presentModes, presentConfig.presentMode);
         VkExtent2D extent = chooseSwapExtent(capabilities, ctx.window, width, height);
 
-        uint32_t imageCount = capabilities.minImageCount + 1;
+        // one image more than can be in flight, so acquiring never waits on a frame still being drawn
+        uint32_t imageCount = std::max(capabilities.minImageCount, presentConfig.framesInFlight) + 1;
         if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
             imageCount = capabilities.maxImageCount;
         }
@@ -652,13 +1086,13 @@ private:
         createInfo.imageColorSpace = surfaceColorSpace;
         createInfo.imageExtent = extent;
         createInfo.imageArrayLayers = 1;
-        createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        createInfo.imageUsage = computePresent ? VK_IMAGE_USAGE_STORAGE_BIT : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
         createInfo.preTransform = capabilities.currentTransform;
         createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
 
-        auto [graphicsAndComputeFamily, presentFamily] = findQueueFamilies(ctx.physicalDevice, ctx.surface);
+        auto [graphicsAndComputeFamily, presentFamily, transferFamily] = findQueueFamilies(ctx.physicalDevice, ctx.surface);
         uint32_t queueFamilyIndices[] = {graphicsAndComputeFamily.value(), presentFamily.value()};
 
         if (graphicsAndComputeFamily != presentFamily) {
@@ -706,18 +1140,28 @@ private:
                 throw std::runtime_error("failed to create image views!");
             }
         }
+
+        // new images have nothing worth keeping, their first frame is drawn in full
+        imageDamage.assign(ctx.swapChainImageViews.size(), DamageRect{});
+        imageHasContent.assign(ctx.swapChainImageViews.size(), false);
     }
 
     void initRenderPass() {
         LOG("..initRenderPass");
+        renderPass = createRenderPass(false);
+        renderPassLoad = createRenderPass(true);
+    }
+
+    /// The load pass starts from the last frame presented from the image instead of clearing it
+    VkRenderPass createRenderPass(bool load) {
         VkAttachmentDescription colorAttachment{};
         colorAttachment.format = ctx.swapChainImageFormat;
         colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.loadOp = load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
         colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachment.initialLayout = load ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED;
         colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         VkAttachmentReference colorAttachmentRef{};
@@ -731,6 +1175,7 @@ private:
         dependency.srcAccessMask = 0;
         dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
         dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        if (load) dependency.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
 
         VkSubpassDescription subpass{};
         subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS; // this can be a compute subpass too!
@@ -746,9 +1191,11 @@ private:
         renderPassInfo.dependencyCount = 1;
         renderPassInfo.pDependencies = &dependency;
 
-        if (vkCreateRenderPass(ctx.device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+        VkRenderPass pass;
+        if (vkCreateRenderPass(ctx.device, &renderPassInfo, nullptr, &pass) != VK_SUCCESS) {
             throw std::runtime_error("failed to create render pass!");
         }
+        return pass;
     }
 
     void initFrameBuffers() {
@@ -775,7 +1222,7 @@ private:
     void initCommands() {
         LOG("..initCommands");
         // Command Pool
-        auto [graphicsAndComputeFamily, presentFamily] = findQueueFamilies(ctx.physicalDevice, ctx.surface);
+        auto [graphicsAndComputeFamily, presentFamily, transferFamily] = findQueueFamilies(ctx.physicalDevice, ctx.surface);
 
         VkCommandPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -792,12 +1239,25 @@ private:
         allocInfo.commandPool = ctx.commandPool;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
         allocInfo.commandBufferCount = 1;
-
-        VkResult graphicsResult = vkAllocateCommandBuffers(ctx.device, &allocInfo, &graphicsCommandBuffer);
         VkResult computeResult = vkAllocateCommandBuffers(ctx.device, &allocInfo, &computeCommandBuffer);
+        if (computeResult == VK_SUCCESS) {
+            computeResult = vkAllocateCommandBuffers(ctx.device, &allocInfo, &rasterCommandBuffer);
+        }
+
+        graphicsCommandBuffers.resize(presentConfig.framesInFlight);
+        allocInfo.commandBufferCount = presentConfig.framesInFlight;
+        VkResult graphicsResult = vkAllocateCommandBuffers(ctx.device, &allocInfo, graphicsCommandBuffers.data());
 
         if (graphicsResult != VK_SUCCESS || computeResult != VK_SUCCESS)
             throw std::runtime_error("failed to allocate command buffers!");
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(ctx.device, &fenceInfo, nullptr, &ctx.singleTimeFence) != VK_SUCCESS)
+            throw std::runtime_error("failed to create single time command fence!");
+
+        uploadRing.init(ctx, ctx.transferQueueFamily, transferQueue);
+        ctx.uploadRing = &uploadRing;
     }
 
     void initDescriptorPool() {
@@ -806,19 +1266,19 @@ private:
         // todo figure out what descriptorCount actually means, and why it needs to be set to 2
         std::array<VkDescriptorPoolSize, 4> poolSizes{};
         poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        poolSizes[0].descriptorCount = 2;
+        poolSizes[0].descriptorCount = 6;
         poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         poolSizes[1].descriptorCount = 2;
         poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-        poolSizes[2].descriptorCount = 2;
+        poolSizes[2].descriptorCount = 2 + presentConfig.framesInFlight;
         poolSizes[3].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[3].descriptorCount = 2;
+        poolSizes[3].descriptorCount = 2 + presentConfig.framesInFlight;
 
         VkDescriptorPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         poolInfo.poolSizeCount = poolSizes.size();
         poolInfo.pPoolSizes = poolSizes.data();
-        poolInfo.maxSets = 3;
+        poolInfo.maxSets = 3 + presentConfig.framesInFlight;
 
         if (vkCreateDescriptorPool(ctx.device, &poolInfo, nullptr, &ctx.descriptorPool) != VK_SUCCESS) {
             throw std::runtime_error("failed to create descriptor pool!");
@@ -962,7 +1422,7 @@ private:
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
         pipelineInfo.basePipelineIndex = -1; // Optional
 
-        if (vkCreateGraphicsPipelines(ctx.device, VK_NULL_HANDLE, 1,
+        if (vkCreateGraphicsPipelines(ctx.device, pipelineCache.cache, 1,
                                       &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
             throw std::runtime_error("failed to create graphics pipeline!");
         }
@@ -977,7 +1437,9 @@ private:
         VkPipeline &pipeline,
         VkPipelineLayout &pipelineLayout,
         const VkDescriptorSetLayout *descriptorLayouts,
-        int descriptorCount
+        int descriptorCount,
+        const VkSpecializationInfo *specialization = nullptr,
+        VkPipelineCreateFlags flags = 0
     ) const {
         LOG("..initPipeline");
 
@@ -988,6 +1450,7 @@ private:
         compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
         compShaderStageInfo.module = compShaderModule;
         compShaderStageInfo.pName = "main";
+        compShaderStageInfo.pSpecializationInfo = specialization;
 
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -1000,10 +1463,11 @@ private:
 
         VkComputePipelineCreateInfo pipelineInfo{};
         pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.flags = flags;
         pipelineInfo.layout = pipelineLayout;
         pipelineInfo.stage = compShaderStageInfo;
 
-        if (vkCreateComputePipelines(ctx.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        if (vkCreateComputePipelines(ctx.device, pipelineCache.cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
             throw std::runtime_error("failed to create compute pipeline!");
         }
 
@@ -1016,23 +1480,57 @@ private:
         uxnDescriptorSet = DescriptorSetWrapper();
         blitDescriptorSet = DescriptorSetWrapper();
         graphicsDescriptorSet = DescriptorSetWrapper();
+        presentDescriptorSets.assign(computePresent ? presentConfig.framesInFlight : 0, DescriptorSetWrapper());
 
         // resource creation
+        VkDeviceSize mappedHeap = memoryArena.heapSize(MAPPED_DEVICE_MEMORY);
+        statePlacement = mappedHeap == 0 ? StatePlacement::Staged
+                       : mappedHeap > SMALL_BAR_SIZE ? StatePlacement::MappedAll
+                       : StatePlacement::MappedShared;
+        if (debug) printStatePlacement();
         sharedUxnResource = Resource(ctx, SHARED_UXN_BINDING, &uxnDescriptorSet,
             sizeof(UxnMemory::shared), &uxn->memory->shared,
-            Resource::ResourceType::SSBO, true);
+            Resource::ResourceType::SSBO, true,
+            statePlacement != StatePlacement::Staged ? MAPPED_DEVICE_MEMORY : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        // a checkpoint is uploaded from its mapping, the host copy catches up through downloadDirtyPages()
+        if (checkpoint) dirtyPages.fill(UINT32_MAX);
         privateUxnResource = Resource(ctx, PRIVATE_UXN_BINDING, &uxnDescriptorSet,
-            sizeof(UxnMemory::_private), &uxn->memory->_private,
-            Resource::ResourceType::SSBO, false);
+            sizeof(UxnMemory::_private), checkpoint ? checkpoint->privateMemory() : &uxn->memory->_private,
+            Resource::ResourceType::SSBO, true,
+            statePlacement == StatePlacement::MappedAll ? MAPPED_DEVICE_MEMORY : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
         initImageResources(uxn_width, uxn_height);
-        vertexResource = Resource(ctx, VERTEX_LOCATION, &graphicsDescriptorSet,
-            VERTICES_SIZE, vertices.data(),
-            Resource::ResourceType::VertexBuffer, false);
+        if (checkpoint && checkpoint->layer(0) != nullptr) {
+            uploadRing.uploadImage(backgroundImageResource.data.image._, checkpoint->layer(0), uxn_width, uxn_height);
+            uploadRing.uploadImage(foregroundImageResource.data.image._, checkpoint->layer(1), uxn_width, uxn_height);
+        }
+        // scratch and ordered command lists for draws done inside Parallel regions
+        drawListResource = Resource(ctx, DRAW_LIST_BINDING, &blitDescriptorSet,
+            2 * DRAW_LIST_SIZE * DRAW_CMD_SIZE, nullptr,
+            Resource::ResourceType::SSBO, false);
+        // decoded sprites, zeroed so every entry starts invalid
+        tileCacheResource = Resource(ctx, TILE_CACHE_BINDING, &blitDescriptorSet,
+            TILE_CACHE_BYTES, nullptr,
+            Resource::ResourceType::SSBO, true);
+        // Screen draw list of deferred mode, the count at its head starts at 0. Without -r blit.comp only reads
+        // the count, so the binding gets just the header.
+        screenListResource = Resource(ctx, SCREEN_LIST_BINDING, &blitDescriptorSet,
+            deferredScreen ? SCREEN_LIST_BYTES : SCREEN_LIST_HEADER, nullptr,
+            Resource::ResourceType::SSBO, false);
+        if (logParallelStats) initStatsBuffer();
+        initPaletteBuffer();
+        if (computePresent) {
+            initPresentBindings();
+        } else {
+            vertexResource = Resource(ctx, VERTEX_LOCATION, &graphicsDescriptorSet,
+                VERTICES_SIZE, vertices.data(),
+                Resource::ResourceType::VertexBuffer, false);
+        }
 
         uxnDescriptorSet.initialise(ctx);
         blitDescriptorSet.initialise(ctx);
         graphicsDescriptorSet.initialise(ctx);
+        for (auto &set : presentDescriptorSets) set.initialise(ctx);
 
         // host staging buffer
         createBuffer(ctx, sizeof(UxnMemory::shared),
@@ -1043,12 +1541,93 @@ private:
             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
             hostSrcBuffer, hostSrcMemory);
-        if (vkMapMemory(ctx.device, hostSrcMemory, 0, sizeof(UxnMemory::shared), 0, &hostSrcP) != VK_SUCCESS) {
-            std::cerr << "Failed to map memory!" << std::endl;
+        hostSrcP = hostSrcMemory.mapped;
+        // dirty pages of private memory are copied here unless it is mapped already
+        if (statePlacement != StatePlacement::MappedAll) {
+            createBuffer(ctx, sizeof(UxnMemory::_private),
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                privateReadbackBuffer, privateReadbackMemory);
         }
+
+        // the uploads run while the pipelines are built, init() waits for them at the end
+        resourceUploads = uploadRing.flush();
+    }
+
+    /// Host visible buffer the PARALLEL_STATS build of blit.comp writes its per-region statistics to
+    void initStatsBuffer() {
+        createBuffer(ctx, sizeof(ParallelStatsBuffer),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            statsBuffer, statsMemory);
+        statsP = static_cast<ParallelStatsBuffer*>(statsMemory.mapped);
+        memset(statsP, 0, sizeof(ParallelStatsBuffer));
+
+        VkDescriptorSetLayoutBinding b{};
+        b.binding = PARALLEL_STATS_BINDING;
+        b.descriptorCount = 1;
+        b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        b.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        blitDescriptorSet.addBinding(b);
+        blitDescriptorSet.addSSBOWrite(statsBuffer, sizeof(ParallelStatsBuffer), PARALLEL_STATS_BINDING);
+    }
+
+    /// Host visible uniform holding the four system colours the fragment shader resolves layer indices with
+    void initPaletteBuffer() {
+        createBuffer(ctx, sizeof(*paletteP),
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            paletteBuffer, paletteMemory);
+        paletteP = static_cast<PaletteUniform*>(paletteMemory.mapped);
+        updatePalette();
+        if (computePresent) return; // bound in the present sets instead
+
+        VkDescriptorSetLayoutBinding b{};
+        b.binding = PALETTE_BINDING;
+        b.descriptorCount = 1;
+        b.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        b.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        graphicsDescriptorSet.addBinding(b);
+        graphicsDescriptorSet.addUBOWrite(paletteBuffer, sizeof(*paletteP), PALETTE_BINDING);
+    }
+
+    /// The palette and the storage image present.comp writes to, pointed at the acquired swapchain image every frame
+    void initPresentBindings() {
+        for (auto &set : presentDescriptorSets) {
+            VkDescriptorSetLayoutBinding b{};
+            b.binding = PRESENT_IMAGE_BINDING;
+            b.descriptorCount = 1;
+            b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            b.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            set.addBinding(b);
+            set.addImageWrite(ctx.swapChainImageViews[0], PRESENT_IMAGE_BINDING);
+
+            b.binding = PALETTE_BINDING;
+            b.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            set.addBinding(b);
+            set.addUBOWrite(paletteBuffer, sizeof(*paletteP), PALETTE_BINDING);
+        }
+    }
+
+    /// Read the System colours, returns true if they changed since the last call
+    bool refreshPalette() {
+        bool changed = false;
+        for (uint8_t i = 0; i < 4; i++) {
+            glm::vec4 colour = uxn->getColor(i);
+            changed |= colour != palette[i];
+            palette[i] = colour;
+        }
+        return changed;
+    }
+
+    /// Copy the System colours into the palette uniform, only called once the previous frame is done with it
+    void updatePalette() const {
+        paletteP->colours = palette;
+        paletteP->size = {uxn_width, uxn_height};
     }
 
     void initImageResources(uint32_t width, uint32_t height) {
+        layerCapacity = {width, height};
         backgroundImageResource = Resource(ctx, BACKGROUND_IMAGE_BINDING, BACKGROUND_SAMPLER_BINDING,
                                            &blitDescriptorSet, &graphicsDescriptorSet, {width, height, 0});
         foregroundImageResource = Resource(ctx, FOREGROUND_IMAGE_BINDING, FOREGROUND_SAMPLER_BINDING,
@@ -1065,28 +1644,45 @@ private:
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
         if (vkCreateFence(ctx.device, &fenceInfo, nullptr, &uxnEvaluationFence) != VK_SUCCESS ||
-            vkCreateFence(ctx.device, &fenceInfo, nullptr, &blitFence) != VK_SUCCESS) {
+            vkCreateFence(ctx.device, &fenceInfo, nullptr, &blitFence) != VK_SUCCESS ||
+            vkCreateFence(ctx.device, &fenceInfo, nullptr, &rasterFence) != VK_SUCCESS) {
             throw std::runtime_error("failed to create synchronization objects!");
         }
 
-        if (vkCreateSemaphore(ctx.device, &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS ||
-            vkCreateSemaphore(ctx.device, &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS ||
-            vkCreateFence(ctx.device, &fenceInfo, nullptr, &graphicsFence) != VK_SUCCESS ||
-            vkCreateFence(ctx.device, &fenceInfo, nullptr, &computeInFlightFence) != VK_SUCCESS) {
-
+        if (vkCreateFence(ctx.device, &fenceInfo, nullptr, &computeInFlightFence) != VK_SUCCESS) {
             throw std::runtime_error("failed to create synchronization objects!");
         }
+
+        imageAvailableSemaphores.resize(presentConfig.framesInFlight);
+        renderFinishedSemaphores.resize(presentConfig.framesInFlight);
+        graphicsFences.resize(presentConfig.framesInFlight);
+        for (uint32_t i = 0; i < presentConfig.framesInFlight; i++) {
+            if (vkCreateSemaphore(ctx.device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+                vkCreateSemaphore(ctx.device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
+                vkCreateFence(ctx.device, &fenceInfo, nullptr, &graphicsFences[i]) != VK_SUCCESS) {
+
+                throw std::runtime_error("failed to create synchronization objects!");
+            }
+        }
     }
 
     void updateUxnConstants() {
         LOG("..updateUxnConstants");
 
-        uxn_width  = static_cast<uint32_t>(WIDTH * H);
-        uxn_height = static_cast<uint32_t>(HEIGHT * H);
+        if (checkpoint) {
+            // the Screen device already holds this size, the window follows before the first frame
+            uxn_width = checkpoint->header().width;
+            uxn_height = checkpoint->header().height;
+            swapChainResizePending = uxn_width != static_cast<uint32_t>(WIDTH * H)
+                                  || uxn_height != static_cast<uint32_t>(HEIGHT * H);
+        } else {
+            uxn_width  = static_cast<uint32_t>(WIDTH * H);
+            uxn_height = static_cast<uint32_t>(HEIGHT * H);
 
-        // Screen Device
-        to_uxn_mem2(static_cast<uint16_t>(uxn_width), &uxn->memory->shared.dev[0x22]);
-        to_uxn_mem2(static_cast<uint16_t>(uxn_height), &uxn->memory->shared.dev[0x24]);
+            // Screen Device
+            to_uxn_mem2(static_cast<uint16_t>(uxn_width), &uxn->memory->shared.dev[0x22]);
+            to_uxn_mem2(static_cast<uint16_t>(uxn_height), &uxn->memory->shared.dev[0x24]);
+        }
 
         // Datetime
         uxn->setDatetime();
@@ -1095,49 +1691,323 @@ private:
         // uxn.dev[0x17] = argc > 2;
     }
 
+    /// Hash of every embedded shader, part of the pipeline cache file name
+    static uint64_t shaderHash() {
+        uint64_t hash = hashBytes(shaders_uxn_emu_spv, shaders_uxn_emu_spv_len);
+        hash = hashBytes(shaders_blit_spv, shaders_blit_spv_len, hash);
+        hash = hashBytes(shaders_blit_stats_spv, shaders_blit_stats_spv_len, hash);
+        hash = hashBytes(shaders_raster_spv, shaders_raster_spv_len, hash);
+        hash = hashBytes(shaders_present_spv, shaders_present_spv_len, hash);
+        hash = hashBytes(shaders_shader_vert_spv, shaders_shader_vert_spv_len, hash);
+        return hashBytes(shaders_shader_frag_spv, shaders_shader_frag_spv_len, hash);
+    }
+
+    /// Starts compiling blit and, when used, raster and present, each as a task after cacheLoad
+    std::vector<StartupTimer::Task> initComputePipelines(const StartupTimer::Task &cacheLoad) {
+        std::vector<StartupTimer::Task> tasks;
+        tasks.push_back(startupTimer.async("blit pipeline", {cacheLoad}, [this] {
+            std::array blitLayouts = {uxnDescriptorSet.layout, blitDescriptorSet.layout};
+            // constant_id 0 of blit.comp: DEFERRED_SCREEN
+            VkBool32 deferred = deferredScreen;
+            VkSpecializationMapEntry deferredEntry{0, 0, sizeof(VkBool32)};
+            VkSpecializationInfo blitSpecialization{1, &deferredEntry, sizeof(VkBool32), &deferred};
+            if (logParallelStats) {
+                initComputePipeline(shaders_blit_stats_spv, shaders_blit_stats_spv_len,
+                    blitPipeline, blitPipelineLayout, blitLayouts.data(), blitLayouts.size(), &blitSpecialization);
+            } else {
+                initComputePipeline(shaders_blit_spv, shaders_blit_spv_len,
+                    blitPipeline, blitPipelineLayout, blitLayouts.data(), blitLayouts.size(), &blitSpecialization);
+            }
+        }));
+        if (deferredScreen) {
+            tasks.push_back(startupTimer.async("raster pipeline", {cacheLoad}, [this] {
+                std::array blitLayouts = {uxnDescriptorSet.layout, blitDescriptorSet.layout};
+                initComputePipeline(shaders_raster_spv, shaders_raster_spv_len,
+                    rasterPipeline, rasterPipelineLayout, blitLayouts.data(), blitLayouts.size());
+            }));
+        }
+        if (computePresent) {
+            tasks.push_back(startupTimer.async("present pipeline", {cacheLoad}, [this] {
+                // the present sets are identical, so any of their layouts will do
+                std::array presentLayouts = {uxnDescriptorSet.layout, blitDescriptorSet.layout,
+                                             presentDescriptorSets[0].layout};
+                initComputePipeline(shaders_present_spv, shaders_present_spv_len,
+                    presentPipeline, presentPipelineLayout, presentLayouts.data(), presentLayouts.size(),
+                    nullptr, VK_PIPELINE_CREATE_DISPATCH_BASE_BIT);
+            }));
+        }
+        return tasks;
+    }
+
+    /// Window, instance and device setup go in order on the main thread, GLFW requires it. The ROM is read
+    /// alongside them, the pipeline cache file is read while the swapchain is built and each compute pipeline
+    /// compiles on a worker of its own, concurrently with the graphics pipeline and the resource uploads.
     void init() {
         LOG("Initialising the Device Controller:");
-        initWindow();
-        initVkInstance();
-        initSurface();
-        initPhysicalDevice();
-        initLogicalDevice();
-        initDebug();
-        initCommands();
-        initSwapChain();
-        initImageViews();
-        initRenderPass();
-        initDescriptorPool();
-        updateUxnConstants();
-        initResources();
-        std::array blitLayouts = {uxnDescriptorSet.layout, blitDescriptorSet.layout};
-        initComputePipeline(shaders_uxn_emu_spv, shaders_uxn_emu_spv_len,
-            uxnEvaluatePipeline, uxnEvaluatePipelineLayout, &uxnDescriptorSet.layout, 1);
-        initComputePipeline(shaders_blit_spv, shaders_blit_spv_len,
-            blitPipeline, blitPipelineLayout, blitLayouts.data(), blitLayouts.size());
-        initFrameBuffers();
-        initGraphicsPipeline();
-        initSync();
+        using Task = StartupTimer::Task;
+        Task romLoad = startupTimer.async("rom load", {}, [this] {
+            uxn = new Uxn(romPath, console, gpuEventQueue);
+            uxn->debug = debug;
+            romHash = hashBytes(reinterpret_cast<const unsigned char*>(uxn->rom().data()), uxn->rom().size());
+            if (watchRom) romWriteTime = romWriteTimeSeen = std::filesystem::last_write_time(romPath);
+        });
+        Task analysis = startupTimer.async("rom analysis", {romLoad}, [this] {
+            romAnalysis = std::make_unique<RomAnalysis>(uxn->rom(), romHash);
+        });
+        Task checkpointLoad = !resume ? romLoad : startupTimer.async("checkpoint load", {romLoad}, [this] {
+            checkpoint = std::make_unique<CheckpointFile>(checkpointPath, romHash);
+            uxn->memory->shared = checkpoint->shared();
+            uxn->restoreCallbackVectors(checkpoint->vectors());
+        });
+        startupTimer.phase("window", [this] { initWindow(); });
+        startupTimer.phase("instance and surface", [this] {
+            initVkInstance();
+            initSurface();
+        });
+        startupTimer.phase("device", [this] {
+            initPhysicalDevice();
+            initLogicalDevice();
+            initDebug();
+            initCommands();
+        });
+        Task cacheLoad = startupTimer.async("pipeline cache load", {}, [this] {
+            pipelineCache.init(ctx.physicalDevice, ctx.device, shaderHash());
+        });
+        startupTimer.phase("swapchain", [this] {
+            initSwapChain();
+            initImageViews();
+            if (!computePresent) initRenderPass();
+            initDescriptorPool();
+        });
+        startupTimer.phase("resources", [this, &checkpointLoad] {
+            checkpointLoad.get();
+            updateUxnConstants();
+            initResources();
+            checkpoint.reset(); // its contents are in the upload ring or the mapped buffers by now
+        });
+
+        // the pipelines only need the descriptor set layouts of initResources and the cache
+        std::vector<Task> computePipelines = initComputePipelines(cacheLoad);
+        startupTimer.phase("graphics pipeline", [this, &cacheLoad] {
+            cacheLoad.get();
+            if (!computePresent) {
+                initFrameBuffers();
+                initGraphicsPipeline();
+            }
+        });
+        startupTimer.phase("sync, uploads and pipelines", [this, &computePipelines, &analysis] {
+            initSync();
+            uploadRing.wait(resourceUploads);
+            for (const Task &task : computePipelines) task.get();
+            analysis.get();
+        });
+        reportRomAnalysis();
+        pipelineCacheSave = startupTimer.async("pipeline cache save", computePipelines, [this] {
+            pipelineCache.save();
+        });
+    }
+
+    /// Summary under -d, and a warning for devices the ROM uses that this VM does not implement
+    void reportRomAnalysis() const {
+        const RomAnalysisHeader &header = romAnalysis->header();
+        LOG("ROM analysis " << (romAnalysis->cached() ? "mapped from the cache" : "computed") << ": "
+            << header.instructionCount << " instructions in " << header.blockCount << " basic blocks");
+        if (romAnalysis->usesPorts(0x30, 0x6f)) std::cerr << "The ROM uses the Audio devices, which are not implemented\n";
+        if (romAnalysis->usesPorts(0xa0, 0xbf)) std::cerr << "The ROM uses the File devices, which are not implemented\n";
+    }
+
+    void printStatePlacement() const {
+        std::cout << "VM state placement: ";
+        switch (statePlacement) {
+        case StatePlacement::Staged:
+            std::cout << "device local, copied through staging buffers\n";
+            break;
+        case StatePlacement::MappedShared:
+            std::cout << "shared state mapped (device local BAR window), private RAM device local\n";
+            break;
+        case StatePlacement::MappedAll:
+            std::cout << "shared state and private RAM mapped (ReBAR or unified memory)\n";
+            break;
+        }
+    }
+
+    /// Makes the shader writes of a dispatch visible to the host, for the state buffers it reads mapped
+    void recordHostReadBarrier(VkCommandBuffer cmdBuffer) const {
+        if (statePlacement == StatePlacement::Staged) return;
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
     }
 
     void copyDeviceMemToHost(UxnMemory* target) {
-        // copy from ssbo buffer to host staging buffer
         auto size = sharedUxnResource.data.buffer.size;
-        copyBuffer(ctx, sharedUxnResource.data.buffer._, hostDestBuffer, size);
+        if (statePlacement != StatePlacement::Staged) {
+            // mapped, the dispatch already waited for and made its writes visible
+            auto* mapped = static_cast<decltype(UxnMemory::shared)*>(sharedUxnResource.data.buffer.memory.mapped);
+            memcpy(&target->shared, mapped, size);
+            memset(mapped->dirty, 0, sizeof(mapped->dirty));
+        } else {
+            // copy from ssbo buffer to host staging buffer
+            copyBuffer(ctx, sharedUxnResource.data.buffer._, hostDestBuffer, size);
 
-        void* data;
-        if (vkMapMemory(ctx.device, hostDestMemory, 0, size, 0, &data) != VK_SUCCESS) {
-            std::cerr << "Failed to map memory!" << std::endl;
-            return;
+            memcpy(&target->shared, hostDestMemory.mapped, size);
         }
+        // the dirty bits move to the host, the zeroed ones go back with the next copyHostMemToDevice()
+        for (uint32_t i = 0; i < UXN_DIRTY_WORDS; i++) dirtyPages[i] |= target->shared.dirty[i];
+        memset(target->shared.dirty, 0, sizeof(target->shared.dirty));
+    }
+
+    /// Polls the ROM's modification time for --watch. A new time only counts once a second poll sees it
+    /// unchanged, so a ROM is not read while the assembler is still writing it.
+    bool romChanged() {
+        auto now = std::chrono::steady_clock::now();
+        if (!watchRom || now < nextRomPoll) return false;
+        nextRomPoll = now + ROM_POLL_INTERVAL;
+
+        std::error_code error;
+        auto time = std::filesystem::last_write_time(romPath, error);
+        if (error) return false; // e.g. between the delete and the write of a new file
+        bool settled = time != romWriteTime && time == romWriteTimeSeen;
+        romWriteTimeSeen = time;
+        if (settled) romWriteTime = time;
+        return settled;
+    }
+
+    /// Writes the VM state and both layers to the checkpoint file on a worker thread, only between vectors.
+    /// The RAM comes from downloadDirtyPages(), so the GPU readback is the pages changed since the last one.
+    void saveCheckpoint() {
+        if (checkpointWrite.valid()) checkpointWrite.get(); // one write at a time
+        downloadDirtyPages();
+        auto state = std::make_shared<CheckpointState>();
+        state->shared = uxn->memory->shared;
+        memset(state->shared.dirty, 0, sizeof(state->shared.dirty));
+        state->_private = uxn->memory->_private;
+        state->vectors = uxn->deviceCallbackVectors;
+        state->width = uxn_width;
+        state->height = uxn_height;
+        readbackLayers(state->layers);
+
+        checkpointWrite = std::async(std::launch::async, [this, state] {
+            try {
+                writeCheckpoint(checkpointPath, romHash, *state);
+                LOG("Checkpoint written to " << checkpointPath);
+            } catch (const std::exception &e) {
+                // the VM keeps running, a later F6 can try again
+                std::cerr << e.what() << std::endl;
+            }
+        });
+    }
+
+    /// Copies the visible part of the background and then the foreground layer to the host
+    void readbackLayers(std::vector<uint8_t> &layers) {
+        VkDeviceSize layerBytes = static_cast<VkDeviceSize>(uxn_width) * uxn_height;
+        VkBuffer buffer;
+        MemoryAllocation memory{};
+        createBuffer(ctx, 2 * layerBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory);
+
+        VkCommandBuffer cmdBuffer = beginSingleTimeCommands(ctx);
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        std::array<VkImage, 2> images = {backgroundImageResource.data.image._, foregroundImageResource.data.image._};
+        for (uint32_t i = 0; i < 2; i++) {
+            VkBufferImageCopy region{};
+            region.bufferOffset = i * layerBytes;
+            region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+            region.imageExtent = {uxn_width, uxn_height, 1};
+            vkCmdCopyImageToBuffer(cmdBuffer, images[i], VK_IMAGE_LAYOUT_GENERAL, buffer, 1, &region);
+        }
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+        endSingleTimeCommands(ctx, cmdBuffer);
+
+        auto* mapped = static_cast<const uint8_t*>(memory.mapped);
+        layers.assign(mapped, mapped + 2 * layerBytes);
+        destroyBuffer(ctx, buffer, memory);
+    }
 
-        auto* mappedMemory = static_cast<UxnMemory*>(data);
-        memset(&target->shared, 0, size);
-        memcpy(&target->shared, mappedMemory, size);
-        vkUnmapMemory(ctx.device, hostDestMemory);
+    /// Copies the whole shared and private VM state between buffer pairs
+    static void copyState(VkCommandBuffer cmdBuffer, VkBuffer srcShared, VkBuffer srcPrivate,
+                          VkBuffer dstShared, VkBuffer dstPrivate) {
+        VkBufferCopy region{};
+        region.size = sizeof(UxnMemory::shared);
+        vkCmdCopyBuffer(cmdBuffer, srcShared, dstShared, 1, &region);
+        region.size = sizeof(UxnMemory::_private);
+        vkCmdCopyBuffer(cmdBuffer, srcPrivate, dstPrivate, 1, &region);
+    }
+
+    /// Brings the host copy of private memory up to date. Only the pages written since the last call are read,
+    /// so dumps and snapshots cost what the program changed rather than the whole 64 KiB.
+    void downloadDirtyPages() {
+        constexpr uint32_t pageCount = (sizeof(UxnMemory::_private) + UXN_PAGE_SIZE - 1) / UXN_PAGE_SIZE;
+        auto* target = reinterpret_cast<uint8_t*>(&uxn->memory->_private);
+
+        // runs of adjacent dirty pages, clamped to the end of the stacks
+        std::vector<VkBufferCopy> regions;
+        for (uint32_t page = 0; page < pageCount; page++) {
+            if (!(dirtyPages[page / 32] & (1u << page % 32))) continue;
+            VkDeviceSize offset = static_cast<VkDeviceSize>(page) * UXN_PAGE_SIZE;
+            VkDeviceSize size = std::min<VkDeviceSize>(UXN_PAGE_SIZE, sizeof(UxnMemory::_private) - offset);
+            if (!regions.empty() && regions.back().srcOffset + regions.back().size == offset) {
+                regions.back().size += size;
+            } else {
+                regions.push_back({offset, offset, size});
+            }
+        }
+        dirtyPages = {};
+        if (regions.empty()) return;
+
+        const void* source = privateUxnResource.data.buffer.memory.mapped;
+        if (statePlacement != StatePlacement::MappedAll) {
+            VkCommandBuffer cmdBuffer = beginSingleTimeCommands(ctx);
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 0, 1, &barrier, 0, nullptr, 0, nullptr);
+            vkCmdCopyBuffer(cmdBuffer, privateUxnResource.data.buffer._, privateReadbackBuffer,
+                            regions.size(), regions.data());
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                                 0, 1, &barrier, 0, nullptr, 0, nullptr);
+            endSingleTimeCommands(ctx, cmdBuffer);
+            source = privateReadbackMemory.mapped;
+        }
+        for (const VkBufferCopy &region : regions) {
+            memcpy(target + region.srcOffset, static_cast<const uint8_t*>(source) + region.srcOffset, region.size);
+        }
+    }
+
+    /// Hit rate of the sprite tile cache, read back from the head of the cache buffer
+    void printTileCacheMetrics() {
+        uint32_t counters[2];
+        copyBuffer(ctx, tileCacheResource.data.buffer._, hostDestBuffer, sizeof(counters));
+
+        memcpy(counters, hostDestMemory.mapped, sizeof(counters));
+
+        uint64_t lookups = static_cast<uint64_t>(counters[0]) + counters[1];
+        std::cout << "Sprite tile cache: " << counters[0] << " hits, " << counters[1] << " misses";
+        if (lookups != 0) std::cout << ", hit rate " << 100.0 * counters[0] / lookups << "%";
+        std::cout << "\n";
     }
 
     void copyHostMemToDevice(const UxnMemory* source) {
+        if (statePlacement != StatePlacement::Staged) {
+            // coherent, visible to the next submission
+            memcpy(sharedUxnResource.data.buffer.memory.mapped, &source->shared, sizeof(UxnMemory::shared));
+            return;
+        }
         // copy data to staging buffer
         memcpy(hostSrcP, &source->shared, sizeof(UxnMemory::shared));
 
@@ -1153,17 +2023,24 @@ private:
             throw std::runtime_error("failed to begin recording command buffer!");
         }
 
+        // an image that was presented before only needs the area damaged since then
+        bool partial = imageHasContent[imageIndex] && !imageDamage[imageIndex].empty();
+        VkRect2D area = partial ? damageArea(imageDamage[imageIndex]) : VkRect2D{{0, 0}, ctx.swapChainExtent};
+        imageDamage[imageIndex] = {};
+        imageHasContent[imageIndex] = true;
+
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.renderPass = partial ? renderPassLoad : renderPass;
         renderPassInfo.framebuffer = ctx.swapChainFramebuffers[imageIndex];
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = ctx.swapChainExtent;
+        renderPassInfo.renderArea = area;
 
         VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
         renderPassInfo.clearValueCount = 1;
         renderPassInfo.pClearValues = &clearColor;
 
+        // the layers go back to GENERAL in the same command buffer, blit.comp runs on this queue after it
+        transitionImagesToReadLayout(cmdBuffer);
         vkCmdBeginRenderPass(cmdBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
         { // Render Pass
             vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
@@ -1179,10 +2056,7 @@ private:
             viewport.maxDepth = 1.0f;
             vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 
-            VkRect2D scissor{};
-            scissor.offset = {0, 0};
-            scissor.extent = ctx.swapChainExtent;
-            vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+            vkCmdSetScissor(cmdBuffer, 0, 1, &area);
 
             VkDeviceSize offsets[] = {0};
             vkCmdBindVertexBuffers(cmdBuffer, VERTEX_BINDING, 1, &vertexResource.data.buffer._, offsets);
@@ -1190,12 +2064,100 @@ private:
             vkCmdDraw(cmdBuffer, vertices.size(), 1, 0, 0);
         }
         vkCmdEndRenderPass(cmdBuffer);
+        transitionImagesToEditLayout(cmdBuffer);
 
         if (vkEndCommandBuffer(cmdBuffer) != VK_SUCCESS) {
             throw std::runtime_error("failed to record command buffer!");
         }
     }
 
+    /// Composites the layers into the swapchain image with present.comp, the layers stay in the GENERAL layout
+    void recordPresentCommandBuffer(VkCommandBuffer cmdBuffer, uint32_t imageIndex) {
+        // the last frame that used this set is done, so it can point at this frame's image
+        DescriptorSetWrapper &presentSet = presentDescriptorSets[currentFrame];
+        presentSet.updateImageWrite(ctx, ctx.swapChainImageViews[imageIndex], PRESENT_IMAGE_BINDING);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+        if (vkBeginCommandBuffer(cmdBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+
+        // an image that was presented before only needs the area damaged since then
+        bool partial = imageHasContent[imageIndex] && !imageDamage[imageIndex].empty();
+        VkRect2D area = partial ? damageArea(imageDamage[imageIndex]) : VkRect2D{{0, 0}, ctx.swapChainExtent};
+        imageDamage[imageIndex] = {};
+        imageHasContent[imageIndex] = true;
+
+        // blit writes and layer clears -> present reads
+        VkMemoryBarrier layerBarrier{};
+        layerBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        layerBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        layerBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        // the old contents are only kept when part of the image is redrawn
+        VkImageMemoryBarrier imageBarrier{};
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.oldLayout = partial ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED;
+        imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = ctx.swapChainImages[imageIndex];
+        imageBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        imageBarrier.srcAccessMask = 0;
+        imageBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &layerBarrier, 0, nullptr, 1, &imageBarrier);
+
+        std::array descriptors = {blitDescriptorSet.set, presentSet.set};
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, presentPipeline);
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, presentPipelineLayout,
+            1, descriptors.size(), descriptors.data(), 0, nullptr);
+
+        // only the workgroups covering the area
+        uint32_t x0 = area.offset.x / PRESENT_GROUP_SIZE;
+        uint32_t y0 = area.offset.y / PRESENT_GROUP_SIZE;
+        uint32_t x1 = (area.offset.x + area.extent.width + PRESENT_GROUP_SIZE - 1) / PRESENT_GROUP_SIZE;
+        uint32_t y1 = (area.offset.y + area.extent.height + PRESENT_GROUP_SIZE - 1) / PRESENT_GROUP_SIZE;
+        vkCmdDispatchBase(cmdBuffer, x0, y0, 0, x1 - x0, y1 - y0, 1);
+
+        // also keeps later blits and clears from writing the layers before this frame has read them
+        imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        imageBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        imageBarrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+        if (vkEndCommandBuffer(cmdBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+    }
+
+    /// Swapchain pixels covering a damaged area of the Uxn screen, rounded outwards
+    [[nodiscard]] VkRect2D damageArea(const DamageRect &damage) const {
+        auto [width, height] = ctx.swapChainExtent;
+        if (computePresent && width >= uxn_width && height >= uxn_height) {
+            // integer scaled and centred by present.comp
+            uint32_t scale = std::min(width / uxn_width, height / uxn_height);
+            uint32_t offsetX = (width - uxn_width * scale) / 2;
+            uint32_t offsetY = (height - uxn_height * scale) / 2;
+            return {{static_cast<int32_t>(offsetX + damage.x0 * scale), static_cast<int32_t>(offsetY + damage.y0 * scale)},
+                    {(damage.x1 - damage.x0) * scale, (damage.y1 - damage.y0) * scale}};
+        }
+        uint32_t x0 = damage.x0 * width / uxn_width;
+        uint32_t y0 = damage.y0 * height / uxn_height;
+        uint32_t x1 = std::min((damage.x1 * width + uxn_width - 1) / uxn_width, width);
+        uint32_t y1 = std::min((damage.y1 * height + uxn_height - 1) / uxn_height, height);
+        return {{static_cast<int32_t>(x0), static_cast<int32_t>(y0)}, {x1 - x0, y1 - y0}};
+    }
+
+    void markFullDamage() {
+        frameDamage.merge({0, 0, uxn_width, uxn_height});
+    }
+
     void clearImage(VkCommandBuffer cmdBuffer) {
         bool singleTimeBuffer = cmdBuffer == VK_NULL_HANDLE;
         if (singleTimeBuffer)
@@ -1208,26 +2170,45 @@ private:
         subresourceRange.baseArrayLayer = 0;
         subresourceRange.layerCount = 1;
 
-        VkClearColorValue foregroundColor = {};
-        foregroundColor.float32[0] = 0.0f;
-        foregroundColor.float32[1] = 0.0f;
-        foregroundColor.float32[2] = 0.0f;
-        foregroundColor.float32[3] = 0.0f;
-
-        auto back = uxn->getBackgroundColor();
-        VkClearColorValue backgroundColor = {};
-        backgroundColor.float32[0] = back.x;
-        backgroundColor.float32[1] = back.y;
-        backgroundColor.float32[2] = back.z;
-        backgroundColor.float32[3] = back.w;
-
-        vkCmdClearColorImage(cmdBuffer, backgroundImageResource.data.image._, VK_IMAGE_LAYOUT_GENERAL, &backgroundColor, 1, &subresourceRange);
-        vkCmdClearColorImage(cmdBuffer, foregroundImageResource.data.image._, VK_IMAGE_LAYOUT_GENERAL, &foregroundColor, 1, &subresourceRange);
+        // background colour 0, foreground transparent
+        VkClearColorValue clearIndex = {};
+        vkCmdClearColorImage(cmdBuffer, backgroundImageResource.data.image._, VK_IMAGE_LAYOUT_GENERAL, &clearIndex, 1, &subresourceRange);
+        vkCmdClearColorImage(cmdBuffer, foregroundImageResource.data.image._, VK_IMAGE_LAYOUT_GENERAL, &clearIndex, 1, &subresourceRange);
 
         if (singleTimeBuffer)
              endSingleTimeCommands(ctx, cmdBuffer);
     }
 
+    /// Clear one layer to a palette index, used for fills that cover the whole layer
+    void clearLayer(VkCommandBuffer cmdBuffer, bool foreground, uint8_t index) {
+        VkImage image = foreground ? foregroundImageResource.data.image._ : backgroundImageResource.data.image._;
+
+        VkImageSubresourceRange subresourceRange{};
+        subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        subresourceRange.baseMipLevel = 0;
+        subresourceRange.levelCount = 1;
+        subresourceRange.baseArrayLayer = 0;
+        subresourceRange.layerCount = 1;
+
+        VkClearColorValue clearColor = {};
+        clearColor.uint32[0] = index;
+
+        // previous blit writes -> clear -> next blit
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        vkCmdClearColorImage(cmdBuffer, image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresourceRange);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
     /// Transition the images formats to edit mode for the blit shader
     void transitionImagesToEditLayout(VkCommandBuffer cmdBuffer) {
         std::array images = {backgroundImageResource.data.image._, foregroundImageResource.data.image._};
@@ -1247,6 +2228,11 @@ private:
     }
 
     void uxnEvalShader() {
+        if (uxnEvaluatePipeline == VK_NULL_HANDLE) {
+            initComputePipeline(shaders_uxn_emu_spv, shaders_uxn_emu_spv_len,
+                uxnEvaluatePipeline, uxnEvaluatePipelineLayout, &uxnDescriptorSet.layout, 1);
+        }
+
         // --- UXN evaluation submission ---
         vkQueueWaitIdle(ctx.computeQueue);
         vkResetFences(ctx.device, 1, &uxnEvaluationFence);
@@ -1263,6 +2249,7 @@ private:
             0,1, &uxnDescriptorSet.set, 0, nullptr);
 
         vkCmdDispatch(computeCommandBuffer, 1, 1, 1);
+        recordHostReadBarrier(computeCommandBuffer);
 
         if (vkEndCommandBuffer(computeCommandBuffer) != VK_SUCCESS) {
             throw std::runtime_error("failed to record command buffer!");
@@ -1290,12 +2277,19 @@ private:
             throw std::runtime_error("failed to begin recording command buffer!");
         }
 
+        // whole-layer fills of the last dispatch, ahead of the draws that follow them
+        for (size_t layer = 0; layer < pendingLayerClears.size(); layer++) {
+            if (pendingLayerClears[layer]) clearLayer(computeCommandBuffer, layer == 1, *pendingLayerClears[layer]);
+            pendingLayerClears[layer].reset();
+        }
+
         std::array descriptors = {uxnDescriptorSet.set, blitDescriptorSet.set};
         vkCmdBindPipeline(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, blitPipeline);
         vkCmdBindDescriptorSets(computeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, blitPipelineLayout,
             0,descriptors.size(), descriptors.data(), 0, nullptr);
 
         vkCmdDispatch(computeCommandBuffer, 1, 1, 1);
+        recordHostReadBarrier(computeCommandBuffer);
 
         if (vkEndCommandBuffer(computeCommandBuffer) != VK_SUCCESS) {
             throw std::runtime_error("failed to record command buffer!");
@@ -1313,10 +2307,73 @@ private:
         vkWaitForFences(ctx.device, 1, &blitFence, VK_TRUE, UINT64_MAX);
     }
 
+    /// Draws the Screen draw list of deferred mode with raster.comp, one invocation per pixel, and empties it.
+    /// Not waited for: the compute and graphics work is submitted to the same queue, so the barriers at the end
+    /// order it before the next blit and the next present.
+    void rasterScreen() {
+        // the previous raster finished long ago, its command buffer is recorded again
+        vkWaitForFences(ctx.device, 1, &rasterFence, VK_TRUE, UINT64_MAX);
+        vkResetFences(ctx.device, 1, &rasterFence);
+        vkResetCommandBuffer(rasterCommandBuffer, 0);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        if (vkBeginCommandBuffer(rasterCommandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+
+        std::array descriptors = {uxnDescriptorSet.set, blitDescriptorSet.set};
+        vkCmdBindPipeline(rasterCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rasterPipeline);
+        vkCmdBindDescriptorSets(rasterCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rasterPipelineLayout,
+            0, descriptors.size(), descriptors.data(), 0, nullptr);
+        vkCmdDispatch(rasterCommandBuffer,
+            (uxn_width + RASTER_GROUP_SIZE - 1) / RASTER_GROUP_SIZE,
+            (uxn_height + RASTER_GROUP_SIZE - 1) / RASTER_GROUP_SIZE, 1);
+
+        // raster reads of the count -> reset -> next blit appends
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(rasterCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+        vkCmdFillBuffer(rasterCommandBuffer, screenListResource.data.buffer._, 0, sizeof(uint32_t), 0);
+        // the reset and the rastered layers -> next blit, present or layer copy
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+                              | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(rasterCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+                             | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        if (vkEndCommandBuffer(rasterCommandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &rasterCommandBuffer;
+        if (vkQueueSubmit(ctx.computeQueue, 1, &submitInfo, rasterFence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit compute command buffer!");
+        }
+    }
+
     void graphicsStep() {
+        VkCommandBuffer graphicsCommandBuffer = graphicsCommandBuffers[currentFrame];
+        VkSemaphore imageAvailableSemaphore = imageAvailableSemaphores[currentFrame];
+        VkSemaphore renderFinishedSemaphore = renderFinishedSemaphores[currentFrame];
+        VkFence graphicsFence = graphicsFences[currentFrame];
+
         // Graphics submission
-        // wait for previous frame to finish
+        // wait for the last frame that used these objects to finish
         vkWaitForFences(ctx.device, 1, &graphicsFence, VK_TRUE, UINT64_MAX);
+        if (paletteDirty) {
+            // the palette uniform is shared by every frame in flight
+            vkWaitForFences(ctx.device, graphicsFences.size(), graphicsFences.data(), VK_TRUE, UINT64_MAX);
+            updatePalette();
+            paletteDirty = false;
+        }
         vkResetFences(ctx.device, 1, &graphicsFence);
 
         // get the next image:
@@ -1324,9 +2381,17 @@ private:
         vkAcquireNextImageKHR(ctx.device, ctx.swapChain, UINT64_MAX, imageAvailableSemaphore,
                               VK_NULL_HANDLE, &imageIndex);
 
+        // every image is now behind by this frame's damage
+        for (auto &damage : imageDamage) damage.merge(frameDamage);
+        frameDamage = {};
+
         // record commands in the current command buffer:
         vkResetCommandBuffer(graphicsCommandBuffer, 0);
-        recordGraphicsCommandBuffer(graphicsCommandBuffer, imageIndex);
+        if (computePresent) {
+            recordPresentCommandBuffer(graphicsCommandBuffer, imageIndex);
+        } else {
+            recordGraphicsCommandBuffer(graphicsCommandBuffer, imageIndex);
+        }
 
         // submit info that accompanies the commands:
         VkSubmitInfo submitInfo{};
@@ -1334,7 +2399,8 @@ private:
         std::array waitSemaphores = {imageAvailableSemaphore};
         submitInfo.waitSemaphoreCount = waitSemaphores.size();
         submitInfo.pWaitSemaphores = waitSemaphores.data();
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+        VkPipelineStageFlags waitStages[] = {computePresent ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                                                            : VK_PIPELINE_STAGE_VERTEX_INPUT_BIT};
         submitInfo.pWaitDstStageMask = waitStages;
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &graphicsCommandBuffer;
@@ -1359,6 +2425,27 @@ private:
 
         // Present Commands get submitted:
         vkQueuePresentKHR(ctx.presentQueue, &presentInfo);
+        currentFrame = (currentFrame + 1) % presentConfig.framesInFlight;
+        if (!firstFramePresented && debug) {
+            std::cout << "First frame presented " << startupTimer.elapsed() << " ms after startup\n";
+            startupTimer.printPhases();
+        }
+        firstFramePresented = true;
+    }
+
+    /// The frame just presented, or kept because nothing changed, shows the result of every input consumed before it
+    void logInputLatencies() {
+        if (!logMetrics) return;
+        auto presented = std::chrono::steady_clock::now();
+        for (auto since : pendingInputs) logger.logInputLatency(presented - since);
+        pendingInputs.clear();
+    }
+
+    /// Whether any device vector is ready to run
+    bool callbackPending(bool did_graphics) {
+        return std::ranges::any_of(CALLBACK_DEVICES, [&](uxn_device device) {
+            return uxn->deviceCallbackVectors.contains(device) && doCallback(device, did_graphics);
+        });
     }
 
     bool doCallback(uxn_device device, bool did_graphics) {
@@ -1376,9 +2463,36 @@ private:
         }
     }
 
-    void recreateImageResources(uint32_t width, uint32_t height){
-        // Recreate image resources
-        initImageResources(width, height);
+    /// Reallocate the layers at a larger size, copying what they hold into the top left of the new images
+    void growLayers(uint32_t width, uint32_t height) {
+        LOG("..growing layers to " << width << "x" << height);
+        // frames in flight may still sample the old images, and the copy below runs on the transfer queue, which
+        // is not ordered after a raster
+        vkWaitForFences(ctx.device, graphicsFences.size(), graphicsFences.data(), VK_TRUE, UINT64_MAX);
+        vkWaitForFences(ctx.device, 1, &rasterFence, VK_TRUE, UINT64_MAX);
+
+        Resource background(ctx, BACKGROUND_IMAGE_BINDING, BACKGROUND_SAMPLER_BINDING,
+                            &blitDescriptorSet, &graphicsDescriptorSet, {width, height, 0, false});
+        Resource foreground(ctx, FOREGROUND_IMAGE_BINDING, FOREGROUND_SAMPLER_BINDING,
+                            &blitDescriptorSet, &graphicsDescriptorSet, {width, height, 0, false});
+
+        // recorded after the fills of the new images, the blits that wrote the old ones have completed
+        VkCommandBuffer cmdBuffer = uploadRing.commandBuffer();
+        VkImageCopy region{};
+        region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.extent = {layerCapacity.width, layerCapacity.height, 1};
+        vkCmdCopyImage(cmdBuffer, backgroundImageResource.data.image._, VK_IMAGE_LAYOUT_GENERAL,
+                       background.data.image._, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+        vkCmdCopyImage(cmdBuffer, foregroundImageResource.data.image._, VK_IMAGE_LAYOUT_GENERAL,
+                       foreground.data.image._, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+        uploadRing.wait(uploadRing.flush());
+
+        backgroundImageResource.destroy();
+        foregroundImageResource.destroy();
+        backgroundImageResource = background;
+        foregroundImageResource = foreground;
+        layerCapacity = {width, height};
 
         // Update descriptor sets with new handles
         for (auto r : {foregroundImageResource, backgroundImageResource}) {
@@ -1388,18 +2502,32 @@ private:
         }
     }
 
-    void cleanupOnResize() {
+    /// Apply a new Screen size. The layers are only reallocated when they are too small, the swapchain
+    /// follows once the vector is done, so a width and a height change cost a single rebuild.
+    void resizeScreen(uint32_t width, uint32_t height) {
+        if (width == uxn_width && height == uxn_height) return;
+        LOG("\nScreen resized to " << width << "x" << height);
+        if (width > layerCapacity.width || height > layerCapacity.height) {
+            growLayers(std::max(width, layerCapacity.width), std::max(height, layerCapacity.height));
+        }
+        uxn_width = width;
+        uxn_height = height;
+        paletteDirty = true; // the uniform carries the visible size
+        markFullDamage();
+        swapChainResizePending = true;
+    }
+
+    void cleanupSwapChain() {
         for (auto framebuffer : ctx.swapChainFramebuffers) {
             vkDestroyFramebuffer(ctx.device, framebuffer, nullptr);
         }
+        ctx.swapChainFramebuffers.clear();
         for (auto imageView : ctx.swapChainImageViews) {
             vkDestroyImageView(ctx.device, imageView, nullptr);
         }
         ctx.swapChainImageViews.clear();
         vkDestroySwapchainKHR(ctx.device, ctx.swapChain, nullptr);
         ctx.swapChain = nullptr;
-        backgroundImageResource.destroy();
-        foregroundImageResource.destroy();
     }
 
     void centreWindow() {
@@ -1411,19 +2539,20 @@ private:
         glfwSetWindowPos(ctx.window, xpos, ypos);
     }
 
-    void recreateOnResize(uint32_t width, uint32_t height) {
-        LOG("..recreating resources on window resize");
+    /// Rebuild the swapchain and the window at the current Screen size, the only place the device is idled
+    void recreateSwapChain() {
+        LOG("..recreating the swapchain on window resize");
         vkDeviceWaitIdle(ctx.device);
 
-        cleanupOnResize();
+        cleanupSwapChain();
 
-        initSwapChain(width, height);
+        initSwapChain(uxn_width, uxn_height);
         initImageViews();
-        initFrameBuffers();
-        recreateImageResources(width, height);
-        glfwSetWindowSize(ctx.window, width, height);
+        if (!computePresent) initFrameBuffers();
+        glfwSetWindowSize(ctx.window, uxn_width, uxn_height);
 
         centreWindow();
+        swapChainResizePending = false;
         LOG("..resize complete\n");
     }
 
@@ -1431,14 +2560,13 @@ private:
         switch (event.type) {
         case GPUEventType::Resize: {
             auto &data = std::get<ResizeData>(event.data);
-            if (data.isWidth){
-                recreateOnResize(data.value, uxn_height);
-                uxn_width = data.value;
-            }
-            else {
-                recreateOnResize(uxn_width, data.value);
-                uxn_height = data.value;
-            }
+            resizeScreen(data.width, data.height);
+            break;
+        }
+        case GPUEventType::Clear: {
+            auto &data = std::get<ClearData>(event.data);
+            pendingLayerClears[data.foreground ? 1 : 0] = data.index;
+            markFullDamage();
             break;
         }
         }
@@ -1448,20 +2576,53 @@ private:
         constexpr int target_FPS = 60;
         constexpr std::chrono::milliseconds frame_duration(1000 / target_FPS);
 
-        glm::uint halt_code = 0;
-        bool in_vector = true, did_graphics = true;
+        // a resumed VM is between vectors, its reset vector ran before the checkpoint was written, so it starts
+        // as if a vector just halted and the first frame presents the restored layers
+        glm::uint halt_code = resume ? 1 : 0;
+        bool in_vector = !resume, did_graphics = true;
+        if (swapChainResizePending) recreateSwapChain(); // the checkpoint was written at another Screen size
         auto last_frame_time = std::chrono::steady_clock::now();
         auto current_vector = uxn_device::Null;
         int callback_index = 0;
         bool show_window = false;
+        std::optional<std::chrono::steady_clock::time_point> reloadTime; // until the reloaded ROM's reset vector is done
+        markFullDamage();
 
         while (!glfwWindowShouldClose(ctx.window) && !uxn->programTerminated()) {
-            glfwPollEvents();
+            if (!in_vector && !callbackPending(did_graphics)) {
+                // nothing to run until the next frame or input, sleep instead of spinning
+                auto remaining = frame_duration - (std::chrono::steady_clock::now() - last_frame_time);
+                glfwWaitEventsTimeout(std::max(std::chrono::duration<double>(remaining).count(), 0.0));
+            } else {
+                glfwPollEvents();
+            }
+
+            // also in the middle of a vector, a ROM stuck in a loop is what is being fixed
+            if (romChanged() && reloadRom()) {
+                if (swapChainResizePending) recreateSwapChain();
+                reloadTime = std::chrono::steady_clock::now();
+                in_vector = true;
+                current_vector = uxn_device::Null;
+                did_graphics = true;
+            }
+
+            if (!in_vector && (snapshotKeys.save || snapshotKeys.restore || snapshotKeys.checkpoint)) {
+                if (snapshotKeys.checkpoint) saveCheckpoint();
+                if (snapshotKeys.save) snapshot(0);
+                if (snapshotKeys.restore && restore(0)) {
+                    if (swapChainResizePending) recreateSwapChain();
+                    did_graphics = true;
+                }
+                snapshotKeys.save = snapshotKeys.restore = snapshotKeys.checkpoint = false;
+            }
 
             if (!in_vector) {
                 // pick a new vector to execute
                 auto callback = CALLBACK_DEVICES[callback_index];
                 if (uxn->deviceCallbackVectors.contains(callback) && doCallback(callback, did_graphics)) {
+                    // every vector is handed the pending mouse and keyboard state
+                    if (logMetrics && mouse.used) pendingInputs.push_back(mouse.since);
+                    if (logMetrics && keyboard.used) pendingInputs.push_back(keyboard.since);
                     uxn->prepareCallback(callback);
                     copyHostMemToDevice(uxn->memory);
                     in_vector = true;
@@ -1478,7 +2639,14 @@ private:
             if (in_vector) {
                 // compute steps
                 blitShader(); // Combined uxn + blit shader
+                if (logParallelStats) parallelStats.collect(statsP);
                 copyDeviceMemToHost(uxn->memory);
+                auto &damage = uxn->memory->shared.damage;
+                frameDamage.merge(DamageRect{damage[0], damage[1], damage[2], damage[3]}.clamped(uxn_width, uxn_height));
+                if (deferredScreen && (uxn->maskFlag(DRAW_FLUSH_FLAG)
+                                       || (uxn->memory->shared.halt == 1 && uxn->maskFlag(DRAW_QUEUED_FLAG)))) {
+                    rasterScreen();
+                }
                 uxn->handleUxnIO();
                 while (auto event = gpuEventQueue->pop()) HandleGpuEvent(*event);
 
@@ -1487,6 +2655,12 @@ private:
 
                 if (halt_code == 1) {
                     in_vector = false;
+                    if (reloadTime) {
+                        std::cout << "Reset vector done " << std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - *reloadTime).count() << " ms after the reload" << std::endl;
+                        reloadTime.reset();
+                    }
+                    if (swapChainResizePending) recreateSwapChain();
                     if (current_vector == uxn_device::Screen) { did_graphics = true; }
                 }
                 if (halt_code == 5) {
@@ -1494,6 +2668,7 @@ private:
                     break;
                 }
 
+            if (debug) downloadDirtyPages(); // for the last instructions below
             LOG("VM halted: halt_code=" << halt_code
                 << ", current_vector=0x" << std::hex << static_cast<int>(current_vector)
                 << ", pc=0x" << static_cast<int>(uxn->memory->shared.pc - 0x100)
@@ -1515,10 +2690,21 @@ private:
             auto now_time = std::chrono::steady_clock::now();
             auto elapsed_since_frame = std::chrono::duration_cast<std::chrono::milliseconds>(now_time - last_frame_time);
             if ((elapsed_since_frame >= frame_duration) && halt_code == 1 && did_graphics) {
-                if (!show_window) glfwShowWindow(ctx.window);
-                transitionImagesToReadLayout(nullptr);
-                graphicsStep();
-                transitionImagesToEditLayout(nullptr);
+                if (refreshPalette()) {
+                    markFullDamage();
+                    paletteDirty = true;
+                }
+                if (!frameDamage.empty() || !show_window) {
+                    if (!show_window) glfwShowWindow(ctx.window);
+                    show_window = true;
+                    graphicsStep();
+                    logInputLatencies();
+                } else if (logMetrics) {
+                    // nothing was drawn, the presented frame is still current and already shows the inputs
+                    // consumed since, logging them later would charge them to an unrelated frame
+                    logger.logSkippedPresent();
+                    logInputLatencies();
+                }
 
                 if (logMetrics) logger.logFrame();
                 last_frame_time = std::chrono::steady_clock::now();
@@ -1530,9 +2716,14 @@ private:
             // check if crashed
             if (halt_code == 4) {
                 copyHostMemToDevice(uxn->memory);
-                std::cerr << "Estimated last opcode before crash: 0x" << std::hex
-                          << uxn->memory->_private.ram[uxn->memory->shared.pc-1]
-                          << std::dec << "\n";
+                downloadDirtyPages();
+                auto* ram = uxn->memory->_private.ram;
+                auto pc = static_cast<uint16_t>(uxn->memory->shared.pc - 1);
+                std::cerr << "Estimated last opcode before crash: 0x" << std::hex << static_cast<int>(ram[pc]);
+                if (uint16_t block = romAnalysis->blockOf(pc)) {
+                    std::cerr << " at 0x" << pc << ", in the basic block at 0x" << block;
+                }
+                std::cerr << std::dec << "\n";
                 throw std::runtime_error("VM encountered unknown opcode!");
             }
         }
@@ -1544,38 +2735,70 @@ private:
 
     void cleanup() {
         vkDeviceWaitIdle(ctx.device);
+        if (checkpointWrite.valid()) checkpointWrite.get();
         delete uxn;
         console->stop();
         uxnDescriptorSet.destroy(ctx);
         blitDescriptorSet.destroy(ctx);
         graphicsDescriptorSet.destroy(ctx);
-        vkUnmapMemory(ctx.device, hostSrcMemory);
-        vkDestroyBuffer(ctx.device, hostDestBuffer, nullptr);
-        vkFreeMemory(ctx.device, hostDestMemory, nullptr);
-        vkDestroyBuffer(ctx.device, hostSrcBuffer, nullptr);
-        vkFreeMemory(ctx.device, hostSrcMemory, nullptr);
-        vkDestroySemaphore(ctx.device, renderFinishedSemaphore, nullptr);
-        vkDestroySemaphore(ctx.device, imageAvailableSemaphore, nullptr);
-        vkDestroyFence(ctx.device, graphicsFence, nullptr);
+        for (auto &set : presentDescriptorSets) set.destroy(ctx);
+        destroyBuffer(ctx, hostDestBuffer, hostDestMemory);
+        destroyBuffer(ctx, hostSrcBuffer, hostSrcMemory);
+        if (privateReadbackBuffer != VK_NULL_HANDLE) destroyBuffer(ctx, privateReadbackBuffer, privateReadbackMemory);
+        for (auto &snap : snapshots) {
+            if (snap.sharedBuffer == VK_NULL_HANDLE) continue;
+            destroyBuffer(ctx, snap.sharedBuffer, snap.sharedMemory);
+            destroyBuffer(ctx, snap.privateBuffer, snap.privateMemory);
+            for (uint32_t i = 0; i < 2; i++) {
+                if (snap.layers[i] != VK_NULL_HANDLE) destroyImage(ctx, snap.layers[i], snap.layerMemory[i]);
+            }
+        }
+        for (uint32_t i = 0; i < presentConfig.framesInFlight; i++) {
+            vkDestroySemaphore(ctx.device, renderFinishedSemaphores[i], nullptr);
+            vkDestroySemaphore(ctx.device, imageAvailableSemaphores[i], nullptr);
+            vkDestroyFence(ctx.device, graphicsFences[i], nullptr);
+        }
         vkDestroyFence(ctx.device, computeInFlightFence, nullptr);
         vkDestroyFence(ctx.device, uxnEvaluationFence, nullptr);
         vkDestroyFence(ctx.device, blitFence, nullptr);
+        vkDestroyFence(ctx.device, rasterFence, nullptr);
         sharedUxnResource.destroy();
         privateUxnResource.destroy();
         backgroundImageResource.destroy();
         foregroundImageResource.destroy();
-        vertexResource.destroy();
+        drawListResource.destroy();
+        tileCacheResource.destroy();
+        screenListResource.destroy();
+        if (!computePresent) vertexResource.destroy();
+        destroyBuffer(ctx, paletteBuffer, paletteMemory);
+        if (logParallelStats) destroyBuffer(ctx, statsBuffer, statsMemory);
+        uploadRing.destroy();
+        memoryArena.destroy();
+        pipelineCacheSave.get();
+        pipelineCache.save(); // picks up pipelines created lazily
+        pipelineCache.destroy();
+        vkDestroyFence(ctx.device, ctx.singleTimeFence, nullptr);
         vkDestroyCommandPool(ctx.device, ctx.commandPool, nullptr);
         for (auto framebuffer : ctx.swapChainFramebuffers) {
             vkDestroyFramebuffer(ctx.device, framebuffer, nullptr);
         }
-        vkDestroyPipeline(ctx.device, graphicsPipeline, nullptr);
         vkDestroyPipeline(ctx.device, uxnEvaluatePipeline, nullptr);
         vkDestroyPipeline(ctx.device, blitPipeline, nullptr);
-        vkDestroyPipelineLayout(ctx.device, graphicsPipelineLayout, nullptr);
         vkDestroyPipelineLayout(ctx.device, uxnEvaluatePipelineLayout, nullptr);
         vkDestroyPipelineLayout(ctx.device, blitPipelineLayout, nullptr);
-        vkDestroyRenderPass(ctx.device, renderPass, nullptr);
+        if (deferredScreen) {
+            vkDestroyPipeline(ctx.device, rasterPipeline, nullptr);
+            vkDestroyPipelineLayout(ctx.device, rasterPipelineLayout, nullptr);
+        }
+        if (computePresent) {
+            vkDestroyPipeline(ctx.device, presentPipeline, nullptr);
+            vkDestroyPipelineLayout(ctx.device, presentPipelineLayout, nullptr);
+        } else {
+            vkDestroyPipeline(ctx.device, graphicsPipeline, nullptr);
+            vkDestroyPipelineLayout(ctx.device, graphicsPipelineLayout, nullptr);
+            vkDestroyRenderPass(ctx.device, renderPass, nullptr);
+            vkDestroyRenderPass(ctx.device, renderPassLoad, nullptr);
+        }
         for (auto imageView : ctx.swapChainImageViews) {
             vkDestroyImageView(ctx.device, imageView, nullptr);
         }
@@ -1596,11 +2819,51 @@ private:
 int main(int nargs, char** args) {
     bool debug = false;
     bool logMetrics = false;
+    bool parallelStats = false;
+    bool deferredScreen = false;
+    PresentConfig presentConfig;
     const char* filename = nullptr;
+    std::string checkpointPath;
+    bool resume = false;
+    bool watchRom = false;
+
+    const std::map<std::string, VkPresentModeKHR> presentModes = {
+        {"fifo", VK_PRESENT_MODE_FIFO_KHR},
+        {"mailbox", VK_PRESENT_MODE_MAILBOX_KHR},
+        {"immediate", VK_PRESENT_MODE_IMMEDIATE_KHR},
+    };
 
     for (int i = 1; i < nargs; ++i) {
         std::string arg = args[i];
-        if (arg[0] == '-' && arg.length() > 1) {
+        if (arg == "--present-mode" || arg == "--frames-in-flight" || arg == "--checkpoint") {
+            if (i + 1 >= nargs) {
+                std::cerr << "Missing value for " << arg << "\n";
+                return EXIT_FAILURE;
+            }
+            std::string value = args[++i];
+            if (arg == "--present-mode") {
+                if (!presentModes.contains(value)) {
+                    std::cerr << "Unknown present mode: " << value << " (fifo, mailbox or immediate)\n";
+                    return EXIT_FAILURE;
+                }
+                presentConfig.presentMode = presentModes.at(value);
+            } else if (arg == "--checkpoint") {
+                checkpointPath = value;
+            } else {
+                int frames = std::atoi(value.c_str());
+                if (frames < 1 || frames > 3) {
+                    std::cerr << "Frames in flight must be 1, 2 or 3\n";
+                    return EXIT_FAILURE;
+                }
+                presentConfig.framesInFlight = frames;
+            }
+        } else if (arg == "--resume") {
+            resume = true;
+        } else if (arg == "--watch") {
+            watchRom = true;
+        } else if (arg == "--snapshot-keys") {
+            snapshotKeys.enabled = true;
+        } else if (arg[0] == '-' && arg.length() > 1) {
             for (size_t j = 1; j < arg.length(); ++j) {
                 switch (arg[j]) {
                     case 'd':
@@ -1609,6 +2872,13 @@ int main(int nargs, char** args) {
                     case 'm':
                         logMetrics = true;
                     break;
+                    case 's':
+                        parallelStats = true;
+                        logMetrics = true;
+                    break;
+                    case 'r':
+                        deferredScreen = true;
+                    break;
                     default:
                         std::cerr << "Unknown flag: -" << arg[j] << "\n";
                     return EXIT_FAILURE;
@@ -1625,20 +2895,22 @@ int main(int nargs, char** args) {
     }
 
     if (!filename) {
-        std::cerr << "Usage: " << args[0] << " [-d] [-m] <filename>\n";
+        std::cerr << "Usage: " << args[0] << " [-d] [-m] [-s] [-r] [--present-mode fifo|mailbox|immediate]"
+                     " [--frames-in-flight 1-3] [--checkpoint <file>] [--resume] [--watch] [--snapshot-keys] <filename>\n";
         return EXIT_FAILURE;
     }
+    if (checkpointPath.empty()) checkpointPath = std::string(filename) + ".checkpoint";
     auto console = new Console;
     EventQueue gpuEventQueue;
-    auto uxn = new Uxn(filename, console, &gpuEventQueue);
-
-    DeviceController app(debug, uxn, console, &gpuEventQueue);
-    app.logMetrics = logMetrics;
 
     std::signal(SIGINT, benchmark_signal_handler);
     std::signal(SIGTERM, benchmark_signal_handler);
 
     try {
+        // the ROM is read during construction, so a missing file is reported here as well
+        DeviceController app(debug, parallelStats, deferredScreen, presentConfig, filename, checkpointPath, resume, watchRom,
+                             console, &gpuEventQueue);
+        app.logMetrics = logMetrics;
         app.run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
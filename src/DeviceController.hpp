@@ -9,6 +9,9 @@
 
 #define LOG(s) if(debug) std::cout << s << std::endl
 
+class MemoryArena;
+class UploadRing;
+
 typedef struct context {
     GLFWwindow* window;
     VkInstance instance;
@@ -20,9 +23,14 @@ typedef struct context {
     VkQueue graphicsQueue;
     VkQueue presentQueue;
     VkQueue computeQueue;
+    uint32_t graphicsQueueFamily;
+    uint32_t transferQueueFamily; // dedicated transfer family of the upload ring, the graphics family if none
 
     VkCommandPool commandPool;
+    VkFence singleTimeFence;
     VkDescriptorPool descriptorPool;
+    MemoryArena* memoryArena; // all buffer and image memory is suballocated from here
+    UploadRing* uploadRing;   // initial contents of buffers and images are written through here
 
     VkSwapchainKHR swapChain;
     std::vector<VkImage> swapChainImages;
@@ -2,14 +2,16 @@
 #include <queue>
 #include <optional>
 #include <variant>
+#include <cstdint>
 
-enum class GPUEventType { Resize};
+enum class GPUEventType { Resize, Clear };
 
-struct ResizeData { bool isWidth; int value; };
+struct ResizeData { uint16_t width; uint16_t height; };
+struct ClearData { bool foreground; uint8_t index; };
 
 struct GPUEvent {
     GPUEventType type;
-    std::variant<ResizeData> data;
+    std::variant<ResizeData, ClearData> data;
 };
 
 class EventQueue {
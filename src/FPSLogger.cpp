@@ -1,4 +1,6 @@
 #include "FPSLogger.hpp"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 void FPSLogger::logStart() {
@@ -20,6 +22,20 @@ void FPSLogger::logFrame() {
     lastFrameTime = now;
 }
 
+void FPSLogger::logSkippedPresent() {
+    skippedPresents++;
+}
+
+void FPSLogger::logInputLatency(std::chrono::duration<double, std::milli> latency) {
+    inputLatencies.push_back(latency.count());
+}
+
+// nearest-rank percentile of sorted samples
+static double percentile(const std::vector<double> &sorted, double p) {
+    auto rank = static_cast<size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
 void FPSLogger::printMetrics() const {
     // Program duration
     double programDurationMs = 0.0;
@@ -52,5 +68,35 @@ void FPSLogger::printMetrics() const {
     std::cout << "Average FPS: " << averageFPS << "\n";
     std::cout << "Minimum frame time: " << minTime << " ms\n";
     std::cout << "Maximum frame time: " << maxTime << " ms\n";
+    std::cout << "Skipped presents: " << skippedPresents << " of " << frameTimes.size() + 1
+              << " frames (screen unchanged)\n";
+
+    if (inputLatencies.empty()) {
+        std::cout << "No input latency samples.\n";
+        return;
+    }
+    std::vector<double> sorted = inputLatencies;
+    std::ranges::sort(sorted);
+    std::cout << "Input to present latency: p50 " << percentile(sorted, 0.5) << " ms, p99 "
+              << percentile(sorted, 0.99) << " ms (" << sorted.size() << " inputs)\n";
+}
+
+
+double StartupTimer::elapsed() const {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - created).count();
 }
 
+void StartupTimer::printPhases() const {
+    std::lock_guard lock(mutex);
+    std::vector<Phase> sorted = phases;
+    std::sort(sorted.begin(), sorted.end(), [](const Phase &a, const Phase &b) { return a.start < b.start; });
+
+    double busy = 0;
+    std::cout << "Startup phases:\n";
+    for (const Phase &p : sorted) {
+        std::cout << "  " << p.name << ": " << p.duration << " ms, from " << p.start << " ms"
+                  << (p.worker ? " (worker)" : "") << "\n";
+        busy += p.duration;
+    }
+    std::cout << "  total: " << elapsed() << " ms, " << busy << " ms of phases\n";
+}
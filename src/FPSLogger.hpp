@@ -5,6 +5,10 @@
 #ifndef FPSLOGGER_HPP
 #define FPSLOGGER_HPP
 #include <chrono>
+#include <future>
+#include <mutex>
+#include <string>
+#include <utility>
 #include <vector>
 
 class FPSLogger {
@@ -15,14 +19,69 @@ public:
 
     void logFrame();
 
+    /// A frame where nothing changed on screen, so the previous image was left up
+    void logSkippedPresent();
+
+    /// Time from an input event to the present of the first frame drawn after a vector consumed it
+    void logInputLatency(std::chrono::duration<double, std::milli> latency);
+
     void printMetrics() const;
 private:
     std::chrono::high_resolution_clock::time_point programStartTime;
     std::chrono::high_resolution_clock::time_point programEndTime;
     std::chrono::high_resolution_clock::time_point lastFrameTime;
     std::vector<double> frameTimes;
+    uint64_t skippedPresents = 0;
+    std::vector<double> inputLatencies;
 
 };
 
 
+/// Wall time of the phases of DeviceController::init(), shown with -d. Phases either run on the calling thread or
+/// as tasks on worker threads that start once the tasks they depend on are done.
+class StartupTimer {
+public:
+    using Task = std::shared_future<void>;
+
+    template<typename F>
+    void phase(const char* name, F &&f) {
+        record(name, f, false);
+    }
+
+    /// Runs f on a worker thread after every task in after, waiting on the returned task rethrows what f or
+    /// any of its dependencies threw
+    template<typename F>
+    Task async(const char* name, std::vector<Task> after, F f) {
+        return std::async(std::launch::async, [this, name, after = std::move(after), f = std::move(f)]() mutable {
+            for (const Task &task : after) task.get();
+            record(name, f, true);
+        }).share();
+    }
+
+    /// Milliseconds since the timer was created
+    double elapsed() const;
+
+    void printPhases() const;
+private:
+    struct Phase {
+        std::string name;
+        double start;
+        double duration;
+        bool worker;
+    };
+
+    std::chrono::steady_clock::time_point created = std::chrono::steady_clock::now();
+    mutable std::mutex mutex;
+    std::vector<Phase> phases;
+
+    template<typename F>
+    void record(const char* name, F &f, bool worker) {
+        double start = elapsed();
+        f();
+        double end = elapsed();
+        std::lock_guard lock(mutex);
+        phases.push_back({name, start, end - start, worker});
+    }
+};
+
 #endif //FPSLOGGER_HPP
@@ -45,6 +45,7 @@ void keyboardInit() {
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
     // button = 0 when left click, button = 1 when right click
     // todo this function sucks
+    if (!mouse.used) mouse.since = std::chrono::steady_clock::now();
     mouse.used = true;
     mouse.mouse1 = false; mouse.mouse2 = false; mouse.mouse3 = false;
     switch (button) {
@@ -63,6 +64,12 @@ void cursorPositionCallback(GLFWwindow* window, double x, double y) {
 
 void keyboardPressCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     if (action != GLFW_RELEASE) { return; }
+    if (snapshotKeys.enabled) {
+        if (key == GLFW_KEY_F5) { snapshotKeys.save = true; return; }
+        if (key == GLFW_KEY_F9) { snapshotKeys.restore = true; return; }
+        if (key == GLFW_KEY_F6) { snapshotKeys.checkpoint = true; return; }
+    }
+    if (!keyboard.used) keyboard.since = std::chrono::steady_clock::now();
     keyboard.used = true;
     if (auto pKey = glfwGetKeyName(key, scancode)) keyboard.key = *pKey;
     if (keymap.contains(scancode)) {keyboard.button = keymap.at(scancode);}
@@ -6,20 +6,33 @@
 #define IO_HPP
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <chrono>
 #include "Uxn.hpp"
 
+// since is when the oldest input not yet handed to a vector arrived, for the latency metrics
 inline struct MouseState {
     bool used = false;
+    std::chrono::steady_clock::time_point since;
     uint16_t cursor_x, cursor_y;
     bool mouse1, mouse2, mouse3;
 } mouse;
 
 inline struct KeyboardState {
     bool used = false;
+    std::chrono::steady_clock::time_point since;
     uint8_t button;
     char8_t key;
 } keyboard;
 
+// With --snapshot-keys, F5 and F9 save and restore snapshot slot 0 and F6 writes the checkpoint file, once the
+// running vector is done. The Controller then never sees these keys, without the flag they reach it as before.
+inline struct SnapshotKeys {
+    bool enabled = false;
+    bool save = false;
+    bool restore = false;
+    bool checkpoint = false;
+} snapshotKeys;
+
 void keyboardInit();
 
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
@@ -0,0 +1,44 @@
+#include "MappedFile.hpp"
+#include <fstream>
+#include <stdexcept>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string &path) {
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open " + path + "!");
+    }
+    contents.resize(file.tellg());
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(contents.data()), static_cast<long>(contents.size()));
+    bytes = contents.data();
+    length = contents.size();
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open " + path + "!");
+    }
+    struct stat info{};
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        length = static_cast<size_t>(info.st_size);
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) bytes = static_cast<const uint8_t*>(mapping);
+    }
+    close(fd); // the mapping stays valid
+#endif
+    if (bytes == nullptr || length == 0) {
+        throw std::runtime_error("failed to map " + path + "!");
+    }
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    munmap(const_cast<uint8_t*>(bytes), length);
+#endif
+}
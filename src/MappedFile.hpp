@@ -0,0 +1,29 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// A whole file mapped read only, so large state is read straight from the page cache instead of copied
+class MappedFile {
+public:
+    /// Throws when the file is missing, empty or cannot be mapped
+    explicit MappedFile(const std::string &path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    [[nodiscard]] const uint8_t* data() const { return bytes; }
+
+    [[nodiscard]] size_t size() const { return length; }
+private:
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    std::vector<uint8_t> contents; // read instead of mapped
+#endif
+};
+
+#endif //MAPPEDFILE_HPP
@@ -0,0 +1,212 @@
+#include "MemoryArena.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void MemoryArena::init(VkPhysicalDevice physicalDevice, VkDevice device) {
+    this->device = device;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    granularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+    maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+}
+
+uint32_t MemoryArena::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+VkDeviceSize MemoryArena::heapSize(VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size;
+        }
+    }
+    return 0;
+}
+
+/// First fit over the free ranges of a block. A range next to one of the other kind (buffer vs image) must not
+/// share a bufferImageGranularity page with it, so the start is pushed to the next page or the range is skipped.
+bool MemoryArena::tryAllocate(Block &block, const VkMemoryRequirements &requirements, bool linear,
+                              VkDeviceSize &offset) const {
+    auto page = [this](VkDeviceSize o) { return o / granularity; };
+
+    for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+        VkDeviceSize freeStart = it->first;
+        VkDeviceSize freeEnd = it->first + it->second;
+
+        VkDeviceSize start = alignUp(freeStart, requirements.alignment);
+        auto next = block.usedRanges.lower_bound(freeEnd);
+        if (next != block.usedRanges.begin()) {
+            auto prev = std::prev(next);
+            VkDeviceSize prevEnd = prev->first + prev->second.size;
+            if (prevEnd <= freeStart && prev->second.linear != linear && page(prevEnd - 1) == page(start)) {
+                start = alignUp(start, granularity);
+            }
+        }
+        VkDeviceSize end = start + requirements.size;
+        if (end > freeEnd) continue;
+        if (next != block.usedRanges.end() && next->second.linear != linear && page(end - 1) == page(next->first)) {
+            continue;
+        }
+
+        // split the free range around the allocation, the alignment padding stays free
+        block.freeRanges.erase(it);
+        if (start > freeStart) block.freeRanges[freeStart] = start - freeStart;
+        if (freeEnd > end) block.freeRanges[end] = freeEnd - end;
+        block.usedRanges[start] = {requirements.size, linear};
+        offset = start;
+        return true;
+    }
+    return false;
+}
+
+uint32_t MemoryArena::newBlock(uint32_t memoryType, VkDeviceSize minSize) {
+    if (liveBlocks >= maxAllocationCount) {
+        throw std::runtime_error("memory arena exceeded maxMemoryAllocationCount!");
+    }
+    const VkMemoryType &type = memoryProperties.memoryTypes[memoryType];
+    VkDeviceSize heapSize = memoryProperties.memoryHeaps[type.heapIndex].size;
+    // small heaps (e.g. the 256 MiB device local and host visible one) are not handed out whole
+    VkDeviceSize size = std::max(std::min<VkDeviceSize>(ARENA_BLOCK_SIZE, heapSize / 8), minSize);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+    Block block{};
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate arena block!");
+    }
+    block.size = size;
+    block.freeRanges[0] = size;
+    if (type.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(device, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mapped) != VK_SUCCESS) {
+            throw std::runtime_error("failed to map arena block!");
+        }
+    }
+    liveBlocks++;
+    deviceAllocations++;
+    reservedBytes += size;
+
+    // reuse the slot of a released block so the indices of live allocations stay valid
+    auto &typeBlocks = blocks[memoryType];
+    for (uint32_t i = 0; i < typeBlocks.size(); i++) {
+        if (typeBlocks[i].memory == VK_NULL_HANDLE) {
+            typeBlocks[i] = std::move(block);
+            return i;
+        }
+    }
+    typeBlocks.emplace_back(std::move(block));
+    return typeBlocks.size() - 1;
+}
+
+MemoryAllocation MemoryArena::allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                                       bool linear) {
+    uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+    auto &typeBlocks = blocks[memoryType];
+
+    VkDeviceSize offset = 0;
+    uint32_t index = 0;
+    bool placed = false;
+    for (; index < typeBlocks.size(); index++) {
+        if (typeBlocks[index].memory != VK_NULL_HANDLE && tryAllocate(typeBlocks[index], requirements, linear, offset)) {
+            placed = true;
+            break;
+        }
+    }
+    if (!placed) {
+        index = newBlock(memoryType, requirements.size);
+        if (!tryAllocate(typeBlocks[index], requirements, linear, offset)) {
+            throw std::runtime_error("failed to place allocation in a new arena block!");
+        }
+    }
+
+    Block &block = typeBlocks[index];
+    MemoryAllocation allocation{};
+    allocation.memory = block.memory;
+    allocation.offset = offset;
+    allocation.size = requirements.size;
+    allocation.mapped = block.mapped != nullptr ? static_cast<char*>(block.mapped) + offset : nullptr;
+    allocation.memoryType = memoryType;
+    allocation.block = index;
+
+    suballocations++;
+    liveAllocations++;
+    usedBytes += requirements.size;
+    peakAllocations = std::max(peakAllocations, liveAllocations);
+    peakUsedBytes = std::max(peakUsedBytes, usedBytes);
+    return allocation;
+}
+
+void MemoryArena::free(const MemoryAllocation &allocation) {
+    Block &block = blocks[allocation.memoryType][allocation.block];
+    auto used = block.usedRanges.find(allocation.offset);
+    if (block.memory != allocation.memory || used == block.usedRanges.end()) {
+        throw std::runtime_error("freeing memory that the arena did not hand out!");
+    }
+    block.usedRanges.erase(used);
+    liveAllocations--;
+    usedBytes -= allocation.size;
+
+    // give the range back, merged with the free ranges either side of it
+    VkDeviceSize start = allocation.offset;
+    VkDeviceSize end = allocation.offset + allocation.size;
+    auto next = block.freeRanges.lower_bound(start);
+    if (next != block.freeRanges.end() && next->first == end) {
+        end += next->second;
+        next = block.freeRanges.erase(next);
+    }
+    if (next != block.freeRanges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == start) {
+            start = prev->first;
+            block.freeRanges.erase(prev);
+        }
+    }
+    block.freeRanges[start] = end - start;
+
+    // the first block of each type is kept for reuse, the others are released once empty
+    if (block.usedRanges.empty() && allocation.block != 0) {
+        if (block.mapped != nullptr) vkUnmapMemory(device, block.memory);
+        vkFreeMemory(device, block.memory, nullptr);
+        reservedBytes -= block.size;
+        liveBlocks--;
+        block = Block{};
+    }
+}
+
+void MemoryArena::destroy() {
+    for (auto &typeBlocks : blocks) {
+        for (auto &block : typeBlocks) {
+            if (block.memory == VK_NULL_HANDLE) continue;
+            if (block.mapped != nullptr) vkUnmapMemory(device, block.memory);
+            vkFreeMemory(device, block.memory, nullptr);
+        }
+        typeBlocks.clear();
+    }
+    liveBlocks = 0;
+    reservedBytes = 0;
+}
+
+void MemoryArena::printMetrics() const {
+    constexpr double MiB = 1024.0 * 1024.0;
+    std::cout << std::fixed << std::setprecision(2)
+              << "Memory arena: " << suballocations << " suballocations from " << deviceAllocations
+              << " device allocations, " << liveAllocations << " live (peak " << peakAllocations << ")"
+              << ", " << usedBytes / MiB << "/" << reservedBytes / MiB << " MiB used (peak "
+              << peakUsedBytes / MiB << " MiB) in " << liveBlocks << " blocks\n";
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << std::setprecision(6);
+}
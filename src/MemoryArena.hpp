@@ -0,0 +1,78 @@
+#ifndef MEMORYARENA_HPP
+#define MEMORYARENA_HPP
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Size of the VkDeviceMemory blocks suballocated from, larger requests get a block of their own
+#define ARENA_BLOCK_SIZE (32ull * 1024 * 1024)
+
+/// A range of a block handed out by MemoryArena, bind with memory and offset
+struct MemoryAllocation {
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    void* mapped; // host pointer to offset for host visible memory, blocks stay mapped for their lifetime
+    uint32_t memoryType;
+    uint32_t block;
+};
+
+/// Suballocates buffers and images from a few large VkDeviceMemory blocks per memory type, so startup and
+/// resizes do not go through vkAllocateMemory for every resource
+class MemoryArena {
+public:
+    void init(VkPhysicalDevice physicalDevice, VkDevice device);
+
+    /// linear is true for buffers and false for optimally tiled images, the two are kept
+    /// bufferImageGranularity apart when they share a block
+    MemoryAllocation allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                              bool linear);
+
+    void free(const MemoryAllocation &allocation);
+
+    /// Size of the heap behind the first memory type with these properties, 0 when there is none
+    VkDeviceSize heapSize(VkMemoryPropertyFlags properties) const;
+
+    void destroy();
+
+    void printMetrics() const;
+private:
+    struct UsedRange {
+        VkDeviceSize size;
+        bool linear;
+    };
+
+    struct Block {
+        VkDeviceMemory memory;
+        VkDeviceSize size;
+        void* mapped;
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges; // offset -> size, never adjacent
+        std::map<VkDeviceSize, UsedRange> usedRanges;    // offset -> range
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    VkDeviceSize granularity = 1;
+    uint32_t maxAllocationCount = 0;
+    std::vector<Block> blocks[VK_MAX_MEMORY_TYPES];
+
+    // statistics
+    uint32_t liveBlocks = 0;
+    uint64_t deviceAllocations = 0;
+    uint64_t suballocations = 0;
+    uint64_t liveAllocations = 0;
+    uint64_t peakAllocations = 0;
+    VkDeviceSize reservedBytes = 0;
+    VkDeviceSize usedBytes = 0;
+    VkDeviceSize peakUsedBytes = 0;
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+    bool tryAllocate(Block &block, const VkMemoryRequirements &requirements, bool linear, VkDeviceSize &offset) const;
+
+    uint32_t newBlock(uint32_t memoryType, VkDeviceSize minSize);
+};
+
+#endif //MEMORYARENA_HPP
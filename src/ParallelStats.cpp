@@ -0,0 +1,65 @@
+#include "ParallelStats.hpp"
+#include <iomanip>
+#include <iostream>
+
+void ParallelStats::collect(ParallelStatsBuffer *buffer) {
+    uint32_t count = buffer->regionCount;
+    if (count > STATS_MAX_REGIONS) {
+        droppedRegions += count - STATS_MAX_REGIONS;
+        count = STATS_MAX_REGIONS;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        const RegionStats &r = buffer->regions[i];
+        auto &t = regions[static_cast<uint16_t>(r.pc)];
+        t.runs++;
+        t.workers += r.workers;
+        t.active += r.active;
+        t.maxInstr += r.maxInstr;
+        t.sumInstr += r.sumInstr;
+        t.maxIter += r.maxIter;
+        t.sumIter += r.sumIter;
+        t.halts += r.halts;
+        t.divergentSteps += r.divergentSteps;
+        t.laneSlots += static_cast<uint64_t>(r.maxInstr) * r.workers;
+        if (r.active != 0) {
+            t.meanInstr += static_cast<double>(r.sumInstr) / r.active;
+            t.meanIter += static_cast<double>(r.sumIter) / r.active;
+        }
+    }
+
+    buffer->regionCount = 0;
+}
+
+void ParallelStats::printMetrics() const {
+    if (regions.empty()) {
+        std::cout << "No Parallel regions recorded.\n";
+        return;
+    }
+
+    std::cout << "Parallel regions:\n";
+    for (const auto &[pc, t] : regions) {
+        // imbalance is max/mean of the active workers, idle is the share of lane slots spent not executing
+        double instrImbalance = t.meanInstr > 0.0 ? static_cast<double>(t.maxInstr) / t.meanInstr : 0.0;
+        double iterImbalance = t.meanIter > 0.0 ? static_cast<double>(t.maxIter) / t.meanIter : 0.0;
+        double idle = t.laneSlots > 0 ? 1.0 - static_cast<double>(t.sumInstr) / t.laneSlots : 0.0;
+        double divergence = t.sumInstr > 0 ? static_cast<double>(t.divergentSteps) / t.sumInstr : 0.0;
+        double activeWorkers = static_cast<double>(t.active) / t.runs;
+        double haltsPerWorker = t.active > 0 ? static_cast<double>(t.halts) / t.active : 0.0;
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << "  pc 0x" << std::hex << std::setw(4) << std::setfill('0') << pc << std::dec << std::setfill(' ')
+                  << ": " << t.runs << " runs"
+                  << ", " << activeWorkers << "/" << t.workers / t.runs << " workers active"
+                  << ", imbalance (max/mean) " << instrImbalance << " instr " << iterImbalance << " iter"
+                  << ", idle " << idle * 100.0 << "%"
+                  << ", divergent steps " << divergence * 100.0 << "%"
+                  << ", halts/worker " << haltsPerWorker << "\n";
+        std::cout.unsetf(std::ios::fixed);
+        std::cout << std::setprecision(6);
+    }
+    if (droppedRegions != 0) {
+        std::cout << "  " << droppedRegions << " regions not recorded (more than "
+                  << STATS_MAX_REGIONS << " in one dispatch)\n";
+    }
+}
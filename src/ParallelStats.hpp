@@ -0,0 +1,55 @@
+#ifndef PARALLELSTATS_HPP
+#define PARALLELSTATS_HPP
+#include <cstdint>
+#include <map>
+
+// Must match STATS_MAX_REGIONS and the Parallel_Stats_Buffer in blit.comp
+#define STATS_MAX_REGIONS 64
+
+struct RegionStats {
+    uint32_t pc;
+    uint32_t workers;
+    uint32_t active;
+    uint32_t maxInstr;
+    uint32_t sumInstr;
+    uint32_t maxIter;
+    uint32_t sumIter;
+    uint32_t halts;
+    uint32_t divergentSteps;
+};
+
+struct ParallelStatsBuffer {
+    uint32_t regionCount;
+    RegionStats regions[STATS_MAX_REGIONS];
+};
+
+/// Summarises the per-region worker statistics written by the PARALLEL_STATS build of blit.comp
+class ParallelStats {
+public:
+    /// Adds the regions recorded during the last dispatch and resets the buffer for the next one
+    void collect(ParallelStatsBuffer *buffer);
+
+    void printMetrics() const;
+private:
+    struct RegionTotals {
+        uint64_t runs = 0;
+        uint64_t workers = 0;
+        uint64_t active = 0;
+        uint64_t maxInstr = 0;
+        uint64_t sumInstr = 0;
+        uint64_t maxIter = 0;
+        uint64_t sumIter = 0;
+        uint64_t halts = 0;
+        uint64_t divergentSteps = 0;
+        // instruction slots of the region: slowest worker * all invocations
+        uint64_t laneSlots = 0;
+        // sum of the active worker means, to average imbalance per run
+        double meanInstr = 0.0;
+        double meanIter = 0.0;
+    };
+    std::map<uint16_t, RegionTotals> regions;
+    uint64_t droppedRegions = 0;
+};
+
+
+#endif //PARALLELSTATS_HPP
@@ -0,0 +1,98 @@
+#include "PipelineCache.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+uint64_t hashBytes(const unsigned char *data, size_t size, uint64_t hash) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::filesystem::path cacheDirectory() {
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) return std::filesystem::path(xdg) / "uxn-on-gpu";
+    if (const char* home = std::getenv("HOME"); home && *home) return std::filesystem::path(home) / ".cache" / "uxn-on-gpu";
+    if (const char* local = std::getenv("LOCALAPPDATA"); local && *local) return std::filesystem::path(local) / "uxn-on-gpu";
+    return {};
+}
+
+void PipelineCache::init(VkPhysicalDevice physicalDevice, VkDevice device, uint64_t shaderHash) {
+    this->device = device;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    std::filesystem::path directory = cacheDirectory();
+    if (!directory.empty()) {
+        std::ostringstream name;
+        name << std::hex << std::setfill('0') << "pipelines-";
+        for (uint8_t b : properties.pipelineCacheUUID) name << std::setw(2) << static_cast<int>(b);
+        name << "-" << std::setw(16) << shaderHash << ".bin";
+        path = directory / name.str();
+
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (file.is_open()) {
+            loaded.resize(file.tellg());
+            file.seekg(0);
+            file.read(loaded.data(), static_cast<long>(loaded.size()));
+        }
+    }
+
+    // the driver checks the header as well, but a truncated or foreign file is dropped here rather than relied on
+    VkPipelineCacheHeaderVersionOne header{};
+    if (loaded.size() >= sizeof(header)) memcpy(&header, loaded.data(), sizeof(header));
+    if (loaded.size() < sizeof(header) || header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        || header.vendorID != properties.vendorID || header.deviceID != properties.deviceID
+        || memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        loaded.clear();
+    }
+
+    VkPipelineCacheCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = loaded.size();
+    createInfo.pInitialData = loaded.data();
+    if (vkCreatePipelineCache(device, &createInfo, nullptr, &cache) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+}
+
+void PipelineCache::save() {
+    if (path.empty()) return;
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS) return;
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) return;
+    data.resize(size);
+    if (data == loaded) return;
+
+    // written next to the file and renamed over it, so a concurrent launch never reads half a cache
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    std::filesystem::path temporary = path;
+    temporary += "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return;
+        file.write(data.data(), static_cast<long>(data.size()));
+        if (!file) {
+            file.close();
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temporary, path, error);
+    if (error) std::filesystem::remove(temporary, error);
+    else loaded = std::move(data);
+}
+
+void PipelineCache::destroy() {
+    vkDestroyPipelineCache(device, cache, nullptr);
+}
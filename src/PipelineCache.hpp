@@ -0,0 +1,34 @@
+#ifndef PIPELINECACHE_HPP
+#define PIPELINECACHE_HPP
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+/// VkPipelineCache kept in a per-user cache file, so later launches skip compiling the shaders again.
+/// The file is named after the pipelineCacheUUID of the device and a hash of the embedded SPIR-V, a new
+/// driver or new shaders therefore start from an empty cache instead of handing stale data to the driver.
+class PipelineCache {
+public:
+    VkPipelineCache cache = VK_NULL_HANDLE;
+
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, uint64_t shaderHash);
+
+    /// Writes the cache file when pipelines were added since it was loaded
+    void save();
+
+    void destroy();
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    std::filesystem::path path; // empty when there is nowhere to keep the file
+    std::vector<char> loaded;
+};
+
+/// FNV-1a, used to key the cache files on the shader binaries and the ROM
+uint64_t hashBytes(const unsigned char *data, size_t size, uint64_t hash = 0xcbf29ce484222325ull);
+
+/// $XDG_CACHE_HOME/uxn-on-gpu, ~/.cache/uxn-on-gpu or %LOCALAPPDATA%/uxn-on-gpu, empty if none is set
+std::filesystem::path cacheDirectory();
+
+#endif //PIPELINECACHE_HPP
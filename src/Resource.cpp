@@ -1,19 +1,18 @@
 #include "Resource.hpp"
+#include <cstring>
 #include <stdexcept>
-
-uint32_t findMemoryType(
-    const Context &ctx,
-    uint32_t typeFilter,
-    VkMemoryPropertyFlags properties
-) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(ctx.physicalDevice, &memProperties);
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
+#include "UploadRing.hpp"
+
+// Resources filled by the upload ring are shared with its queue when that is a separate transfer family
+static void setUploadSharing(const Context &ctx, VkSharingMode &mode, uint32_t &count, const uint32_t *&indices,
+                             const uint32_t (&families)[2]) {
+    if (ctx.transferQueueFamily == ctx.graphicsQueueFamily) {
+        mode = VK_SHARING_MODE_EXCLUSIVE;
+        return;
     }
-    throw std::runtime_error("failed to find suitable memory type!");
+    mode = VK_SHARING_MODE_CONCURRENT;
+    count = 2;
+    indices = families;
 }
 
 void createBuffer(
@@ -22,13 +21,18 @@ void createBuffer(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer& buffer,
-    VkDeviceMemory& bufferMemory
+    MemoryAllocation& bufferMemory
 ) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
     bufferInfo.usage = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    const uint32_t families[] = {ctx.graphicsQueueFamily, ctx.transferQueueFamily};
+    if (usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) {
+        setUploadSharing(ctx, bufferInfo.sharingMode, bufferInfo.queueFamilyIndexCount,
+                         bufferInfo.pQueueFamilyIndices, families);
+    }
 
     if (vkCreateBuffer(ctx.device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to create buffer!");
@@ -37,16 +41,48 @@ void createBuffer(
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(ctx.device, buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(ctx,memRequirements.memoryTypeBits,properties);
+    bufferMemory = ctx.memoryArena->allocate(memRequirements, properties, true);
+    vkBindBufferMemory(ctx.device, buffer, bufferMemory.memory, bufferMemory.offset);
+}
 
-    if (vkAllocateMemory(ctx.device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate buffer memory!");
+void destroyBuffer(const Context &ctx, VkBuffer buffer, const MemoryAllocation &bufferMemory) {
+    vkDestroyBuffer(ctx.device, buffer, nullptr);
+    ctx.memoryArena->free(bufferMemory);
+}
+
+void createImage(
+    const Context &ctx,
+    uint32_t width,
+    uint32_t height,
+    VkImage& image,
+    MemoryAllocation& imageMemory
+) {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = {width, height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = LAYER_FORMAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    if (vkCreateImage(ctx.device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
     }
 
-    vkBindBufferMemory(ctx.device, buffer, bufferMemory, 0);
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(ctx.device, image, &memRequirements);
+
+    imageMemory = ctx.memoryArena->allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+    vkBindImageMemory(ctx.device, image, imageMemory.memory, imageMemory.offset);
+}
+
+void destroyImage(const Context &ctx, VkImage image, const MemoryAllocation &imageMemory) {
+    vkDestroyImage(ctx.device, image, nullptr);
+    ctx.memoryArena->free(imageMemory);
 }
 
 void copyBuffer(
@@ -148,33 +184,6 @@ void transitionImageLayout(
     }
 }
 
-void copyBufferToImage(const Context &ctx, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands(ctx);
-
-    VkBufferImageCopy region{};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {width, height, 1};
-
-    vkCmdCopyBufferToImage(
-        commandBuffer,
-        buffer,
-        image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1,
-        &region
-    );
-
-    endSingleTimeCommands(ctx, commandBuffer);
-}
-
-
 // -- Descriptor Set Wrapper --
 void DescriptorSetWrapper::initialise(const Context &ctx) {
     // Descriptor Layout
@@ -367,7 +376,8 @@ Resource::Resource(
     size_t bufferSize,
     const void* bufferData,
     ResourceType bufferType,
-    bool isTransferSource
+    bool isTransferSource,
+    VkMemoryPropertyFlags memoryProperties
 ) {
     this->type = bufferType;
     this->binding = binding;
@@ -375,18 +385,6 @@ Resource::Resource(
     this->data.buffer.descriptorSet = descriptorSet;
     this->data.buffer.size = bufferSize;
 
-    // Staging buffer
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(ctx, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingBuffer, stagingBufferMemory);
-
-    void* p;
-    vkMapMemory(ctx.device, stagingBufferMemory, 0, bufferSize, 0, &p);
-    memcpy(p, bufferData, bufferSize);
-    vkUnmapMemory(ctx.device, stagingBufferMemory);
-
     VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
     if (isTransferSource) usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 
@@ -397,12 +395,18 @@ Resource::Resource(
         default: throw std::invalid_argument("Image type cannot be used in buffer constructor");
     }
 
-    createBuffer(ctx, bufferSize, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    createBuffer(ctx, bufferSize, usage, memoryProperties,
                  this->data.buffer._, this->data.buffer.memory);
-    copyBuffer(ctx, stagingBuffer, this->data.buffer._, bufferSize);
-
-    vkDestroyBuffer(ctx.device, stagingBuffer, nullptr);
-    vkFreeMemory(ctx.device, stagingBufferMemory, nullptr);
+    if (this->data.buffer.memory.mapped != nullptr) {
+        if (bufferData != nullptr) memcpy(this->data.buffer.memory.mapped, bufferData, bufferSize);
+        else memset(this->data.buffer.memory.mapped, 0, bufferSize);
+    }
+    // recorded only, the owner flushes the upload ring before the buffer is used
+    else if (bufferData != nullptr) {
+        ctx.uploadRing->uploadBuffer(this->data.buffer._, bufferData, bufferSize);
+    } else {
+        ctx.uploadRing->fillBuffer(this->data.buffer._, 0);
+    }
 
     switch (bufferType) {
         case SSBO: {
@@ -447,27 +451,6 @@ Resource::Resource(
     this->data.image.imageDescriptorSet = imageDescriptorSet;
     this->data.image.samplerDescriptorSet = samplerDescriptorSet;
 
-    // Allocate memory for the image
-    auto* pixels = new uint8_t[params.width * params.height * 4];
-
-    // memset(pixels, params.color, params.width * params.height * 4);
-    for (size_t i = 0; i < params.width * params.height; i++) {
-        reinterpret_cast<uint32_t *>(pixels)[i] = params.color;
-    }
-
-    VkDeviceSize imageSize = params.width * params.height * sizeof(uint32_t);
-
-    // making a buffer and copying the pixel data into it
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    auto usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    auto properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    createBuffer(ctx, imageSize, usage, properties, stagingBuffer, stagingBufferMemory);
-    void* data;
-    vkMapMemory(ctx.device, stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, imageSize);
-    vkUnmapMemory(ctx.device, stagingBufferMemory);
-
     // creating a vulkan image object
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -477,11 +460,15 @@ Resource::Resource(
     imageInfo.extent.depth = 1;
     imageInfo.mipLevels = 1;
     imageInfo.arrayLayers = 1;
-    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM; //VK_FORMAT_R8G8B8A8_SRGB;
+    imageInfo.format = LAYER_FORMAT;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
+                    | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    const uint32_t families[] = {ctx.graphicsQueueFamily, ctx.transferQueueFamily};
+    setUploadSharing(ctx, imageInfo.sharingMode, imageInfo.queueFamilyIndexCount,
+                     imageInfo.pQueueFamilyIndices, families);
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.flags = 0; // Optional
     if (vkCreateImage(ctx.device, &imageInfo, nullptr, &this->data.image._) != VK_SUCCESS) {
@@ -491,26 +478,18 @@ Resource::Resource(
     // binding the image
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(ctx.device, this->data.image._, &memRequirements);
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(ctx, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    if (vkAllocateMemory(ctx.device, &allocInfo, nullptr, &this->data.image.memory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
-    }
-    vkBindImageMemory(ctx.device, this->data.image._, this->data.image.memory, 0);
+    this->data.image.memory = ctx.memoryArena->allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+    vkBindImageMemory(ctx.device, this->data.image._, this->data.image.memory.memory, this->data.image.memory.offset);
 
-    // preparing the image to be copied into, and then copying the pixel date from the staging buffer into it
-    transitionImageLayout(ctx, 1, &this->data.image._, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, nullptr);
-    copyBufferToImage(ctx, stagingBuffer, this->data.image._, params.width, params.height);
-    transitionImageLayout(ctx, 1, &this->data.image._, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, nullptr);
+    // filling the image with the starting palette index, recorded only like the buffer uploads
+    ctx.uploadRing->fillImage(this->data.image._, params.width, params.height, params.index);
 
     // creating the image view object
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = this->data.image._;
     viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM; //VK_FORMAT_R8G8B8A8_SRGB;
+    viewInfo.format = LAYER_FORMAT;
     viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     viewInfo.subresourceRange.baseMipLevel = 0;
     viewInfo.subresourceRange.levelCount = 1;
@@ -537,7 +516,7 @@ Resource::Resource(
     samplerInfo.unnormalizedCoordinates = VK_FALSE;
     samplerInfo.compareEnable = VK_FALSE;
     samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
     samplerInfo.maxLod = 0.0f;
@@ -545,10 +524,7 @@ Resource::Resource(
         throw std::runtime_error("failed to create texture sampler!");
     }
 
-    // freeing stuff
-    delete[] pixels;
-    vkDestroyBuffer(ctx.device, stagingBuffer, nullptr);
-    vkFreeMemory(ctx.device, stagingBufferMemory, nullptr);
+    if (!params.addBindings) return;
 
     // updating the descriptor set
     VkDescriptorSetLayoutBinding imageLayoutBinding{};
@@ -573,14 +549,13 @@ void Resource::destroy() const {
         case SSBO:
         case UBO:
         case VertexBuffer:
-            vkDestroyBuffer(ctx->device, this->data.buffer._, nullptr);
-            vkFreeMemory(ctx->device, this->data.buffer.memory, nullptr);
+            destroyBuffer(*ctx, this->data.buffer._, this->data.buffer.memory);
             break;
         case Image:
             vkDestroySampler(ctx->device, this->data.image.sampler, nullptr);
             vkDestroyImageView(ctx->device, this->data.image.view, nullptr);
             vkDestroyImage(ctx->device, this->data.image._, nullptr);
-            vkFreeMemory(ctx->device, this->data.image.memory, nullptr);
+            ctx->memoryArena->free(this->data.image.memory);
             break;
     }
 }
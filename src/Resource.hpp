@@ -6,12 +6,7 @@
 #include <glm/vec4.hpp>
 
 #include "DeviceController.hpp"
-
-uint32_t findMemoryType(
-    const Context &ctx,
-    uint32_t typeFilter,
-    VkMemoryPropertyFlags properties
-);
+#include "MemoryArena.hpp"
 
 void createBuffer(
     const Context &ctx,
@@ -19,9 +14,22 @@ void createBuffer(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer& buffer,
-    VkDeviceMemory& bufferMemory
+    MemoryAllocation& bufferMemory
+);
+
+void destroyBuffer(const Context &ctx, VkBuffer buffer, const MemoryAllocation &bufferMemory);
+
+/// Device local layer image without view or sampler, only copied to and from, starts UNDEFINED
+void createImage(
+    const Context &ctx,
+    uint32_t width,
+    uint32_t height,
+    VkImage& image,
+    MemoryAllocation& imageMemory
 );
 
+void destroyImage(const Context &ctx, VkImage image, const MemoryAllocation &imageMemory);
+
 void copyBuffer(
     const Context &ctx,
     VkBuffer srcBuffer,
@@ -31,13 +39,15 @@ void copyBuffer(
 
 void transitionImageLayout(const Context &ctx, int imageCount, const VkImage *image, VkImageLayout oldLayout, VkImageLayout newLayout, VkCommandBuffer cmdBuffer);
 
-void copyBufferToImage(const Context &ctx, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 
+// Layers hold one palette index per pixel, resolved to a colour in shader.frag.glsl
+#define LAYER_FORMAT VK_FORMAT_R8_UINT
 
 struct ImageParams {
     uint32_t width;
     uint32_t height;
-    uint32_t color;
+    uint8_t index;
+    bool addBindings = true; // false for an image replacing one whose descriptor writes already exist
 };
 
 
@@ -86,13 +96,13 @@ public:
     union ResourceData {
         struct BufferData {
             VkBuffer _;
-            VkDeviceMemory memory;
+            MemoryAllocation memory;
             VkDeviceSize size;
             DescriptorSetWrapper* descriptorSet;
         } buffer;
         struct ImageData {
             VkImage _;
-            VkDeviceMemory memory;
+            MemoryAllocation memory;
             VkImageView view;
             VkSampler sampler;
             uint32_t samplerBinding;
@@ -105,6 +115,8 @@ public:
     Resource() : type(), ctx(nullptr),
                  binding(0), data() {}
 
+    /// bufferData is copied in through the upload ring, nullptr zero-fills the buffer. Host visible memory
+    /// is written directly instead and stays mapped at data.buffer.memory.mapped
     Resource(
         Context &ctx,
         uint32_t binding,
@@ -112,7 +124,8 @@ public:
         size_t bufferSize,
         const void* bufferData,
         ResourceType resourceType,
-        bool isTransferSource
+        bool isTransferSource,
+        VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
     );
 
     Resource(
@@ -0,0 +1,228 @@
+#include "RomAnalysis.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <string>
+
+#include "PipelineCache.hpp"
+#include "Uxn.hpp"
+
+#define ROM_START 0x0100
+// opcodes without modes, their low five bits are 0
+#define OP_BRK 0x00
+#define OP_JCI 0x20
+#define OP_JMI 0x40
+// low five bits of the moded opcodes
+#define OP_JMP 0x0c
+#define OP_JCN 0x0d
+#define OP_JSR 0x0e
+#define OP_DEI 0x16
+#define OP_DEO 0x17
+#define MODE_SHORT  0x20
+#define MODE_RETURN 0x40
+#define MODE_KEEP   0x80
+
+/// A literal pushed by LIT, LIT2, LITr or LIT2r
+struct Literal {
+    uint16_t value;
+    bool isShort;
+    bool ret;
+    bool valid;
+};
+
+static bool isVectorPort(uint8_t port) {
+    return std::any_of(CALLBACK_DEVICES.begin(), CALLBACK_DEVICES.end(),
+                       [port](uxn_device device) { return static_cast<uint8_t>(device) == port; });
+}
+
+/// Recursive descent from the reset vector, through every jump and vector whose target is a literal right
+/// before it, so bytes only reached through computed addresses stay undecoded.
+static std::vector<uint8_t> analyse(const std::vector<char> &rom, uint64_t romHash) {
+    const auto size = static_cast<uint32_t>(rom.size());
+    auto inRom = [size](uint32_t address) { return address >= ROM_START && address - ROM_START < size; };
+    auto byte = [&](uint32_t address) -> uint8_t {
+        return inRom(address) ? static_cast<uint8_t>(rom[address - ROM_START]) : 0;
+    };
+
+    RomAnalysisHeader header{};
+    std::vector<uint8_t> flags(size);
+    std::set<uint16_t> leaders = {ROM_START};
+    std::vector<uint32_t> pending = {ROM_START};
+    auto follow = [&](uint32_t target) {
+        target &= 0xffff;
+        if (!inRom(target)) return;
+        leaders.insert(target);
+        pending.push_back(target);
+    };
+
+    while (!pending.empty()) {
+        uint32_t pc = pending.back();
+        pending.pop_back();
+        // the last two literals of this run, ports and jump targets are pushed right before their use
+        Literal last{}, beforeLast{};
+        while (inRom(pc) && !(flags[pc - ROM_START] & (ROM_CODE | ROM_OPERAND))) {
+            uint8_t op = byte(pc);
+            flags[pc - ROM_START] |= ROM_CODE;
+            header.instructionCount++;
+            uint32_t next = pc + 1;
+            bool continues = true, branches = false;
+            Literal literal{};
+
+            if ((op & 0x1f) == 0) {
+                uint32_t operands = op == OP_BRK ? 0 : (op & MODE_KEEP) && !(op & MODE_SHORT) ? 1 : 2;
+                for (uint32_t i = 1; i <= operands && inRom(pc + i); i++) flags[pc + i - ROM_START] |= ROM_OPERAND;
+                next = pc + 1 + operands;
+                if (op & MODE_KEEP) {
+                    uint16_t value = operands == 2 ? (byte(pc + 1) << 8) | byte(pc + 2) : byte(pc + 1);
+                    literal = {value, operands == 2, (op & MODE_RETURN) != 0, true};
+                } else if (op == OP_BRK) {
+                    continues = false;
+                } else {
+                    // JCI, JMI and JSI, relative to the next instruction
+                    follow(next + ((byte(pc + 1) << 8) | byte(pc + 2)));
+                    continues = op != OP_JMI;
+                    branches = true;
+                }
+            } else {
+                uint8_t base = op & 0x1f;
+                bool isShort = op & MODE_SHORT, ret = op & MODE_RETURN;
+                bool afterLiteral = last.valid && last.ret == ret;
+                if (base == OP_JMP || base == OP_JCN || base == OP_JSR) {
+                    // e.g. ;label JMP2 or ,label JCN, a byte is an offset from the next instruction
+                    if (afterLiteral && last.isShort == isShort) {
+                        follow(isShort ? last.value : next + static_cast<int8_t>(last.value));
+                    }
+                    continues = base != OP_JMP;
+                    branches = true;
+                } else if ((base == OP_DEI || base == OP_DEO) && afterLiteral && !last.isShort) {
+                    uint32_t* ports = base == OP_DEI ? header.deiPorts : header.deoPorts;
+                    for (uint32_t port = last.value; port <= std::min<uint32_t>(last.value + isShort, 0xff); port++) {
+                        ports[port / 32] |= 1u << (port % 32);
+                    }
+                    // e.g. ;on-frame .Screen/vector DEO2
+                    if (base == OP_DEO && isShort && isVectorPort(last.value)
+                        && beforeLast.valid && beforeLast.isShort && beforeLast.ret == ret) {
+                        follow(beforeLast.value);
+                    }
+                }
+            }
+
+            if (branches && continues && inRom(next)) leaders.insert(next);
+            beforeLast = last;
+            last = literal;
+            if (!continues) break;
+            pc = next;
+        }
+    }
+
+    std::vector<uint16_t> blocks;
+    for (uint16_t leader : leaders) {
+        if (!(flags[leader - ROM_START] & ROM_CODE)) continue; // a target inside an operand
+        flags[leader - ROM_START] |= ROM_BLOCK_START;
+        blocks.push_back(leader);
+    }
+
+    memcpy(header.magic, ROM_ANALYSIS_MAGIC, sizeof(header.magic));
+    header.version = ROM_ANALYSIS_VERSION;
+    header.romSize = size;
+    header.romHash = romHash;
+    header.blockCount = blocks.size();
+    std::vector<uint8_t> result(sizeof(header) + blocks.size() * sizeof(uint16_t) + size);
+    memcpy(result.data(), &header, sizeof(header));
+    memcpy(result.data() + sizeof(header), blocks.data(), blocks.size() * sizeof(uint16_t));
+    memcpy(result.data() + sizeof(header) + blocks.size() * sizeof(uint16_t), flags.data(), size);
+    return result;
+}
+
+static bool isValid(const uint8_t* data, size_t size, size_t romSize, uint64_t romHash) {
+    RomAnalysisHeader header{};
+    if (size < sizeof(header)) return false;
+    memcpy(&header, data, sizeof(header));
+    return memcmp(header.magic, ROM_ANALYSIS_MAGIC, sizeof(header.magic)) == 0
+        && header.version == ROM_ANALYSIS_VERSION && header.romSize == romSize && header.romHash == romHash
+        && size >= sizeof(header) + header.blockCount * sizeof(uint16_t) + romSize;
+}
+
+/// <cache directory>/roms/<hash>.bin, empty when there is no cache directory
+static std::filesystem::path cachePath(uint64_t romHash) {
+    std::filesystem::path directory = cacheDirectory();
+    if (directory.empty()) return {};
+    std::ostringstream name;
+    name << std::hex << std::setfill('0') << std::setw(16) << romHash << ".bin";
+    return directory / "roms" / name.str();
+}
+
+/// Written next to the file and renamed over it like the pipeline cache, failures only cost the next launch a pass
+static void save(const std::filesystem::path &path, const std::vector<uint8_t> &data) {
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    std::filesystem::path temporary = path;
+    temporary += "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return;
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<long>(data.size()));
+        if (!file) {
+            file.close();
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temporary, path, error);
+    if (error) std::filesystem::remove(temporary, error);
+}
+
+RomAnalysis::RomAnalysis(const std::vector<char> &rom, uint64_t romHash) {
+    std::filesystem::path path = cachePath(romHash);
+    if (!path.empty()) {
+        try {
+            file = std::make_unique<MappedFile>(path.string());
+            if (!isValid(file->data(), file->size(), rom.size(), romHash)) file.reset();
+        } catch (const std::exception &) {
+            // not cached yet
+        }
+    }
+    if (file) {
+        data = file->data();
+        return;
+    }
+
+    computed = analyse(rom, romHash);
+    data = computed.data();
+    if (!path.empty()) save(path, computed);
+}
+
+const RomAnalysisHeader &RomAnalysis::header() const {
+    return *reinterpret_cast<const RomAnalysisHeader*>(data);
+}
+
+const uint16_t* RomAnalysis::blocks() const {
+    return reinterpret_cast<const uint16_t*>(data + sizeof(RomAnalysisHeader));
+}
+
+uint8_t RomAnalysis::flags(uint16_t address) const {
+    const RomAnalysisHeader &h = header();
+    if (address < ROM_START || static_cast<uint32_t>(address - ROM_START) >= h.romSize) return 0;
+    return data[sizeof(RomAnalysisHeader) + h.blockCount * sizeof(uint16_t) + address - ROM_START];
+}
+
+uint16_t RomAnalysis::blockOf(uint16_t address) const {
+    if (!(flags(address) & ROM_CODE)) return 0;
+    const uint16_t* first = blocks();
+    const uint16_t* end = first + header().blockCount;
+    const uint16_t* block = std::upper_bound(first, end, address);
+    return block == first ? 0 : *(block - 1);
+}
+
+bool RomAnalysis::usesPorts(uint8_t first, uint8_t last) const {
+    const RomAnalysisHeader &h = header();
+    for (uint32_t port = first; port <= last; port++) {
+        if (((h.deiPorts[port / 32] | h.deoPorts[port / 32]) >> (port % 32)) & 1) return true;
+    }
+    return false;
+}
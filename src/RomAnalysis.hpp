@@ -0,0 +1,58 @@
+#ifndef ROMANALYSIS_HPP
+#define ROMANALYSIS_HPP
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+#define ROM_ANALYSIS_MAGIC   "UXNROMA"
+#define ROM_ANALYSIS_VERSION 1
+// per address flags of the decoded instruction table
+#define ROM_CODE        0x1 // opcode reached from the reset vector, a vector or a jump
+#define ROM_OPERAND     0x2 // immediate of LIT, LIT2, JCI, JMI or JSI
+#define ROM_BLOCK_START 0x4 // first instruction of a basic block
+
+/// Start of a cached analysis. It is followed by blockCount block start addresses (uint16_t, ascending) and
+/// romSize flag bytes, one per ROM byte from 0x0100 on.
+struct RomAnalysisHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t romSize;
+    uint64_t romHash;          // hashBytes() of the ROM, also the file name
+    uint32_t instructionCount;
+    uint32_t blockCount;
+    uint32_t deiPorts[8];      // one bit per device port read through a literal port
+    uint32_t deoPorts[8];      // one bit per device port written through a literal port
+};
+
+/// What a static pass over the ROM finds: which bytes are code, where the basic blocks start and which device
+/// ports are used. Kept in a per-user cache directory under the ROM's hash and mapped by later launches, so
+/// the pass only runs once per ROM however much it grows.
+class RomAnalysis {
+public:
+    /// Maps the cached analysis of rom, or analyses it and writes the cache file when there is none
+    RomAnalysis(const std::vector<char> &rom, uint64_t romHash);
+
+    /// True when mapped from the cache rather than computed
+    [[nodiscard]] bool cached() const { return file != nullptr; }
+
+    [[nodiscard]] const RomAnalysisHeader &header() const;
+
+    /// ROM_* flags of an address, 0 outside the ROM
+    [[nodiscard]] uint8_t flags(uint16_t address) const;
+
+    /// Start of the basic block an instruction at address belongs to, 0 when the address is not decoded code
+    [[nodiscard]] uint16_t blockOf(uint16_t address) const;
+
+    /// True when any port in [first, last] is read or written through a literal port
+    [[nodiscard]] bool usesPorts(uint8_t first, uint8_t last) const;
+private:
+    std::unique_ptr<MappedFile> file;
+    std::vector<uint8_t> computed; // in the file layout, when there was no usable cache file
+    const uint8_t* data;
+
+    [[nodiscard]] const uint16_t* blocks() const;
+};
+
+#endif //ROMANALYSIS_HPP
@@ -0,0 +1,225 @@
+#include "UploadRing.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "Resource.hpp"
+
+// keeps buffer to image copies valid on transfer only queues, where offsets must be a multiple of 4
+#define UPLOAD_ALIGNMENT 16
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void UploadRing::init(const Context &ctx, uint32_t queueFamily, VkQueue queue) {
+    this->ctx = &ctx;
+    this->queue = queue;
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = queueFamily;
+    if (vkCreateCommandPool(ctx.device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload command pool!");
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    for (auto &batch : batches) {
+        if (vkAllocateCommandBuffers(ctx.device, &allocInfo, &batch.commandBuffer) != VK_SUCCESS ||
+            vkCreateFence(ctx.device, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload batch!");
+        }
+    }
+
+    createBuffer(ctx, UPLOAD_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 buffer, memory);
+}
+
+UploadRing::Batch &UploadRing::recordingBatch() {
+    Batch &batch = batches[current];
+    if (!batch.recording) {
+        wait(batch.ticket); // the command buffer may still be in flight from its last use
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin upload batch!");
+        }
+        batch.recording = true;
+        batch.bytes = 0;
+    }
+    return batch;
+}
+
+bool UploadRing::retireOldest() {
+    if (completed == submitted) return false;
+    for (auto &batch : batches) {
+        if (batch.ticket != completed + 1) continue;
+        vkWaitForFences(ctx->device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+        used -= batch.bytes;
+        tail = batch.end;
+        completed = batch.ticket;
+        return true;
+    }
+    throw std::runtime_error("upload batch tickets out of order!");
+}
+
+VkDeviceSize UploadRing::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    if (size > UPLOAD_RING_SIZE) {
+        throw std::runtime_error("upload larger than the upload ring!");
+    }
+    while (true) {
+        if (used == 0) head = tail = 0;
+        VkDeviceSize start = alignUp(head, alignment);
+        VkDeviceSize consumed = 0;
+        if (head > tail || used == 0) {
+            if (start + size <= UPLOAD_RING_SIZE) {
+                consumed = start - head + size;
+            } else if (size <= tail) {
+                // the end of the ring is too short, skip it and start over at 0
+                start = 0;
+                consumed = UPLOAD_RING_SIZE - head + size;
+            }
+        } else if (start + size <= tail) {
+            consumed = start - head + size;
+        }
+
+        if (consumed != 0) {
+            recordingBatch().bytes += consumed;
+            used += consumed;
+            head = start + size;
+            return start;
+        }
+        // full, reuse the space of the oldest batch, submitting the one being recorded if it is the only one
+        if (!retireOldest()) {
+            flush();
+            retireOldest();
+        }
+    }
+}
+
+void UploadRing::uploadBuffer(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset) {
+    // large uploads go in pieces so they never need the whole ring at once
+    constexpr VkDeviceSize chunk = UPLOAD_RING_SIZE / 2;
+    for (VkDeviceSize done = 0; done < size; done += chunk) {
+        VkDeviceSize n = std::min(chunk, size - done);
+        VkDeviceSize offset = allocate(n, UPLOAD_ALIGNMENT);
+        memcpy(static_cast<char*>(memory.mapped) + offset, static_cast<const char*>(data) + done, n);
+
+        VkBufferCopy region{};
+        region.srcOffset = offset;
+        region.dstOffset = dstOffset + done;
+        region.size = n;
+        vkCmdCopyBuffer(recordingBatch().commandBuffer, buffer, dst, 1, &region);
+    }
+}
+
+void UploadRing::fillBuffer(VkBuffer dst, uint32_t value) {
+    vkCmdFillBuffer(recordingBatch().commandBuffer, dst, 0, VK_WHOLE_SIZE, value);
+}
+
+void UploadRing::fillImage(VkImage image, uint32_t width, uint32_t height, uint8_t value) {
+    // one row in the ring, copied to every row of the image
+    VkDeviceSize offset = allocate(width, UPLOAD_ALIGNMENT);
+    memset(static_cast<char*>(memory.mapped) + offset, value, width);
+    VkCommandBuffer cmdBuffer = recordingBatch().commandBuffer;
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    std::vector<VkBufferImageCopy> regions(height);
+    for (uint32_t y = 0; y < height; y++) {
+        regions[y].bufferOffset = offset;
+        regions[y].imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        regions[y].imageOffset = {0, static_cast<int32_t>(y), 0};
+        regions[y].imageExtent = {width, 1, 1};
+    }
+    vkCmdCopyBufferToImage(cmdBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           regions.size(), regions.data());
+
+    // later transfers in the batch may copy into the image, the shaders only see it after the batch's fence
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void UploadRing::uploadImage(VkImage image, const void* data, uint32_t width, uint32_t height) {
+    // whole rows at a time, so every piece is a single region
+    const uint32_t rowsPerChunk = std::max<uint32_t>(1, UPLOAD_RING_SIZE / 2 / width);
+    for (uint32_t y = 0; y < height; y += rowsPerChunk) {
+        uint32_t rows = std::min(rowsPerChunk, height - y);
+        VkDeviceSize size = static_cast<VkDeviceSize>(rows) * width;
+        VkDeviceSize offset = allocate(size, UPLOAD_ALIGNMENT);
+        memcpy(static_cast<char*>(memory.mapped) + offset,
+               static_cast<const char*>(data) + static_cast<VkDeviceSize>(y) * width, size);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = offset;
+        region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+        region.imageOffset = {0, static_cast<int32_t>(y), 0};
+        region.imageExtent = {width, rows, 1};
+        vkCmdCopyBufferToImage(recordingBatch().commandBuffer, buffer, image, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+    }
+}
+
+VkCommandBuffer UploadRing::commandBuffer() {
+    return recordingBatch().commandBuffer;
+}
+
+uint64_t UploadRing::flush() {
+    Batch &batch = batches[current];
+    if (!batch.recording) return submitted;
+
+    if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record upload batch!");
+    }
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.commandBuffer;
+    vkResetFences(ctx->device, 1, &batch.fence);
+    if (vkQueueSubmit(queue, 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit upload batch!");
+    }
+
+    batch.recording = false;
+    batch.ticket = ++submitted;
+    batch.end = head;
+    current = (current + 1) % UPLOAD_RING_BATCHES;
+    return batch.ticket;
+}
+
+void UploadRing::wait(uint64_t ticket) {
+    while (completed < ticket) retireOldest();
+}
+
+void UploadRing::destroy() {
+    wait(flush());
+    for (auto &batch : batches) {
+        vkDestroyFence(ctx->device, batch.fence, nullptr);
+    }
+    vkDestroyCommandPool(ctx->device, commandPool, nullptr);
+    destroyBuffer(*ctx, buffer, memory);
+}
@@ -0,0 +1,75 @@
+#ifndef UPLOADRING_HPP
+#define UPLOADRING_HPP
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <array>
+#include <cstdint>
+
+#include "DeviceController.hpp"
+#include "MemoryArena.hpp"
+
+#define UPLOAD_RING_SIZE    (4 * 1024 * 1024)
+#define UPLOAD_RING_BATCHES 3
+
+/// Persistent host visible staging buffer that uploads are written into back to back. The copies out of it
+/// are recorded into one command buffer per batch and submitted together by flush(), each batch signals its
+/// own fence and its part of the ring is reused once that fence is seen, so nothing waits for a queue to idle.
+class UploadRing {
+public:
+    /// queueFamily is a dedicated transfer family when the device has one, the graphics family otherwise
+    void init(const Context &ctx, uint32_t queueFamily, VkQueue queue);
+
+    void uploadBuffer(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+
+    /// Sets every 32-bit word of dst to value, no ring space needed
+    void fillBuffer(VkBuffer dst, uint32_t value);
+
+    /// Fills every pixel of an R8 image with value and leaves it in the GENERAL layout
+    void fillImage(VkImage image, uint32_t width, uint32_t height, uint8_t value);
+
+    /// Copies width * height tightly packed bytes into an R8 image in the GENERAL layout, e.g. after fillImage()
+    void uploadImage(VkImage image, const void* data, uint32_t width, uint32_t height);
+
+    /// The command buffer of the batch being recorded, for transfers that do not come from the ring
+    VkCommandBuffer commandBuffer();
+
+    /// Submits the batch being recorded, returns a ticket to wait() on
+    uint64_t flush();
+
+    /// Blocks until the batch with this ticket, and all before it, completed
+    void wait(uint64_t ticket);
+
+    void destroy();
+private:
+    struct Batch {
+        VkCommandBuffer commandBuffer;
+        VkFence fence;
+        uint64_t ticket;      // 0 while not submitted
+        VkDeviceSize bytes;   // ring bytes used, padding included
+        VkDeviceSize end;     // ring head when submitted
+        bool recording;
+    };
+
+    const Context* ctx = nullptr;
+    VkQueue queue = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    MemoryAllocation memory{};
+    std::array<Batch, UPLOAD_RING_BATCHES> batches{};
+    uint32_t current = 0;
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+
+    // the bytes in use are [tail, head), wrapping around the end of the ring
+    VkDeviceSize head = 0;
+    VkDeviceSize tail = 0;
+    VkDeviceSize used = 0;
+
+    Batch &recordingBatch();
+
+    VkDeviceSize allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+    bool retireOldest();
+};
+
+#endif //UPLOADRING_HPP
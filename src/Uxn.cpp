@@ -26,23 +26,10 @@ uxn_memory::uxn_memory() = default;
 Uxn::Uxn(const char *program_path, Console *console, EventQueue *gpuEventQueue) {
     this->console = console;
     this->program_path = std::string(program_path);
-    this->program_rom = readFile(program_path);
     this->gpuEventQueue = gpuEventQueue;
-
-    if (program_rom.size() + 0x0100 > UXN_RAM_SIZE) {
-        throw std::runtime_error("uxn program is bigger than uxn ram!");
-    }
-
     this->memory = new UxnMemory();
-    memset(memory, 0, sizeof(UxnMemory));
-    // copy the program into memory
-    memcpy(memory->_private.ram + 0x0100, program_rom.data(), program_rom.size());
-    // set the program counter to where the program starts from
-    memory->shared.pc = 0x0100;
-
     this->original_memory = new UxnMemory();
-    memset(original_memory, 0, sizeof(UxnMemory));
-    memcpy(original_memory, memory, sizeof(UxnMemory));
+    reload();
 }
 
 Uxn::~Uxn() {
@@ -51,7 +38,32 @@ Uxn::~Uxn() {
 }
 
 void Uxn::reset() {
-    memory = original_memory;
+    memcpy(memory, original_memory, sizeof(UxnMemory));
+    deviceCallbackVectors.clear();
+}
+
+void Uxn::reload() {
+    std::vector<char> rom = readFile(program_path);
+    if (rom.size() + 0x0100 > UXN_RAM_SIZE) {
+        throw std::runtime_error("uxn program is bigger than uxn ram!");
+    }
+    program_rom = std::move(rom);
+
+    memset(original_memory, 0, sizeof(UxnMemory));
+    // copy the program into memory
+    memcpy(original_memory->_private.ram + 0x0100, program_rom.data(), program_rom.size());
+    // set the program counter to where the program starts from
+    original_memory->shared.pc = 0x0100;
+    console_buffer.clear();
+    cerror_buffer.clear();
+    reset();
+}
+
+void Uxn::restoreCallbackVectors(const std::unordered_map<uxn_device,uint16_t> &vectors) {
+    deviceCallbackVectors = vectors;
+    if (deviceCallbackVectors.contains(uxn_device::Console)) {
+        console->start();
+    }
 }
 
 void Uxn::outputToFile(const char* output_file_name, bool showRAM) const {
@@ -134,12 +146,12 @@ void Uxn::setDatetime() const {
 }
 
 void Uxn::handleUxnIO() {
+    // a dispatch can end with several flags set, e.g. a Screen size change that did not halt, so each is handled
     if (maskFlag(DEO_CONSOLE_FLAG)) {
         // console output
         char8_t c = from_uxn_mem(&memory->shared.dev[0x18]);
         console_buffer.push_back(static_cast<char>(c));
         if (c == 0x0a) { printBuffer(); }
-        return;
     }
     if (maskFlag(DEO_CERROR_FLAG)) {
         // console error output
@@ -149,21 +161,18 @@ void Uxn::handleUxnIO() {
             std::cerr << "[ERROR] " << cerror_buffer;
             cerror_buffer.clear();
         }
-        return;
     }
-    if (maskFlag(DEO_SCREENW_FLAG)) {
-        // screen resize
-        char16_t w = from_uxn_mem2(&memory->shared.dev[0x22]);
-        gpuEventQueue->push({GPUEventType::Resize, ResizeData{true, static_cast<int>(w)}});
-        LOG("\nuxn requested width: " << static_cast<int>(w));
-        return;
+    if (maskFlag(DEO_SCREENW_FLAG) || maskFlag(DEO_SCREENH_FLAG)) {
+        // screen resize, width and height written in the same dispatch become one event
+        uint16_t w = from_uxn_mem2(&memory->shared.dev[0x22]);
+        uint16_t h = from_uxn_mem2(&memory->shared.dev[0x24]);
+        gpuEventQueue->push({GPUEventType::Resize, ResizeData{w, h}});
+        LOG("\nuxn requested screen size: " << w << "x" << h);
     }
-    if (maskFlag(DEO_SCREENH_FLAG)) {
-        // screen resize
-        char16_t h = from_uxn_mem2(&memory->shared.dev[0x24]);
-        gpuEventQueue->push({GPUEventType::Resize, ResizeData{false, static_cast<int>(h)}});
-        LOG("\nuxn requested height: " << static_cast<int>(h));
-        return;
+    if (maskFlag(DRAW_CLEAR_FLAG)) {
+        // fill of a whole layer
+        uint8_t pixel = from_uxn_mem(&memory->shared.dev[0x2e]);
+        gpuEventQueue->push({GPUEventType::Clear, ClearData{(pixel & 0x40) != 0, static_cast<uint8_t>(pixel & 0x03)}});
     }
     // callbacks
     if (maskFlag(DEO_FLAG)) {
@@ -179,7 +188,6 @@ void Uxn::handleUxnIO() {
                 }
             }
         }
-        return;
     }
 }
 
@@ -192,6 +200,10 @@ void Uxn::printBuffer() {
     console_buffer.clear();
 }
 
+const std::vector<char> &Uxn::rom() const {
+    return program_rom;
+}
+
 bool Uxn::programTerminated() const {
     return static_cast<int8_t>(from_uxn_mem(&memory->shared.dev[0x0f])) != 0;
 }
@@ -200,8 +212,8 @@ bool Uxn::maskFlag(uint16_t mask) const {
     return (memory->shared.flags & mask) == mask;
 }
 
-glm::vec4 Uxn::getBackgroundColor() const {
-    constexpr int shift = 12;
+glm::vec4 Uxn::getColor(uint8_t index) const {
+    const int shift = (3 - (index & 0x3)) * 4;
     constexpr float f = 15.0f;
     auto r = static_cast<float>((from_uxn_mem2(&memory->shared.dev[0x08]) >> shift) & 0xf);
     auto g = static_cast<float>((from_uxn_mem2(&memory->shared.dev[0x0a]) >> shift) & 0xf);
@@ -12,6 +12,9 @@
 #define UXN_RAM_SIZE 65536
 #define UXN_STACK_SIZE 256
 #define UXN_DEV_SIZE 256
+// Private memory is read back in pages, one dirty bit each
+#define UXN_PAGE_SIZE 256
+#define UXN_DIRTY_WORDS 9
 // Uxn deviceFlags
 #define DEO_FLAG         0x001
 #define DEO_CONSOLE_FLAG 0x002
@@ -19,8 +22,11 @@
 #define DEO_SCREENW_FLAG 0x008
 #define DEO_SCREENH_FLAG 0x010
 #define DEI_CONSOLE_FLAG 0x020
+#define DRAW_CLEAR_FLAG  0x040
+#define DRAW_FLUSH_FLAG  0x080
 #define DRAW_PIXEL_FLAG  0x100
 #define DRAW_SPRITE_FLAG 0x200
+#define DRAW_QUEUED_FLAG 0x400
 
 typedef struct uxn_memory {
     struct shared {
@@ -28,6 +34,8 @@ typedef struct uxn_memory {
         uint8_t dev[UXN_DEV_SIZE];
         uint16_t flags;
         uint8_t halt;
+        uint32_t damage[4]; // x0, y0, x1, y1 of the pixels drawn by the last dispatch, empty if x0 >= x1
+        uint32_t dirty[UXN_DIRTY_WORDS]; // pages of _private written since the host last read them, one bit each
     } shared;
     struct _private {
         uint8_t ram[UXN_RAM_SIZE];
@@ -38,6 +46,7 @@ typedef struct uxn_memory {
     } _private;
     uxn_memory();
 } UxnMemory;
+static_assert(UXN_DIRTY_WORDS * 32 * UXN_PAGE_SIZE >= sizeof(UxnMemory::_private));
 
 enum class uxn_device: uint8_t {
     System = 0x0,
@@ -78,8 +87,15 @@ public:
 
     ~Uxn();
 
+    /// Back to the state right after the ROM was loaded, only the host copy
     void reset();
 
+    /// Reads the ROM file again and resets to it, the loaded ROM is kept when that throws
+    void reload();
+
+    /// Replaces the callback vectors with saved ones, starting the Console class when they include its vector
+    void restoreCallbackVectors(const std::unordered_map<uxn_device,uint16_t> &vectors);
+
     void outputToFile(const char* output_file_name, bool showRAM) const;
 
     void prepareCallback(uxn_device callback);
@@ -97,7 +113,10 @@ public:
     bool maskFlag(uint16_t mask) const;
 
     [[nodiscard]]
-    glm::vec4 getBackgroundColor() const;
+    glm::vec4 getColor(uint8_t index) const;
+
+    [[nodiscard]]
+    const std::vector<char> &rom() const;
 private:
     UxnMemory* original_memory;
     std::string program_path;